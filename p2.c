@@ -18,174 +18,3981 @@
  * number of threads to start, and the number of loops for each thread.
  * If no command-line arguments are provided, this program starts 2
  * threads, each doing 10 million loops.
+ *
+ * the option --mode=NAME selects how the increment is synchronized, so
+ * that the same thread and loop settings can be used to compare the
+ * different strategies.  See the modes[] table below for the names.
  */
 
+#define _GNU_SOURCE                 // for strsep, CLOCK_MONOTONIC_RAW and CPU affinity on Linux
+
 #include <stdio.h>
 #include <pthread.h>
 #include <stdlib.h>
 #include <unistd.h>
 #include <time.h>
-#include <sys/time.h>
+#include <string.h>
+#include <stdatomic.h>
+#include <errno.h>
+#include <limits.h>
+#include <stdarg.h>
+#include <sched.h>
+#include <sys/resource.h>
+#include <sys/utsname.h>
+#ifdef __GLIBC__
+#include <gnu/libc-version.h>
+#endif
+
+#ifdef __linux__
+#include <sys/syscall.h>
+#include <sys/ioctl.h>
+#include <linux/perf_event.h>
+#define HAVE_AFFINITY                   // pthread_attr_setaffinity_np and mbind
+#define HAVE_PERF                       // perf_event_open
+#define HAVE_FUTEX
+#include <linux/futex.h>
+#ifndef MPOL_BIND                       // from numaif.h, which is not always installed
+#define MPOL_BIND	2
+#define MPOL_MF_MOVE	(1 << 1)
+#endif
+#endif
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#include <cpuid.h>
+#include <immintrin.h>
+#define HAVE_RTM                        // Intel TSX, if the CPU has it, see rtm_available
+#define RTM_TARGET	__attribute__ ((target ("rtm")))
+#else
+#define RTM_TARGET
+#endif
 
 #define LOOPS	10 * 1000 * 1000
 #define THREADS	2
+#define REPEAT	5                   // default number of runs per sweep configuration
+#define MAX_LIST	16                  // most values in a comma-separated option
+#define QUEUE_SIZE	1024                // default --queue-size
+#define SAMPLE_EVERY	64                  // default --latency, and always for the queue kernel
+#define MAX_FIELDS	96                  // most fields in a --json or --csv record
+#define THRESHOLD	5                   // default --threshold, in percent
+#define HIST_SUB_BITS	5                   // histogram buckets per power of 2: 1 << HIST_SUB_BITS
+#define SPINS	100                 // default spins before the spinpark lock parks
+#define COHORT_PASSES	64                  // default most handoffs within a socket in cohort mode
+#define ELIDE_TRIES	3                   // transactions started before taking countLock in elided mode
+#define TRACE_EVENTS	4096                // per-thread ring of --trace lock waits, the oldest overwritten
+#define TRACE_WAIT_NS	1000                // --trace: lock acquisitions at least this long are contended
+#define MAX_BACKOFF	64                  // most pauses between two tries of the spinpark lock
 //#define DEBUG
 
-//first run indicator, used in thread()
-static int firstRun = 1; //1 for first run, 0 else
-
 //create the mutex 
 static pthread_mutex_t countLock;   //ensures no race conditions on the counter
+static pthread_mutex_t adaptiveLock; //countLock, but PTHREAD_MUTEX_ADAPTIVE_NP where available
+static pthread_rwlock_t countRwLock; //rwlock mode: readers share it, writers hold it alone
 static pthread_mutex_t decreLock;   //ensures no race conditions on decrement & end 
-static pthread_mutex_t mainLock;    //locks the main thread while other threads are running
-static pthread_mutex_t threadLock;  //locks the the threads while the main is creating other threads
 
-//create the condition 
-static int threadComplete  = 0;   
-static pthread_cond_t waitCond;     //prevents spinning in main 
+#define CACHE_LINE	64
 
-struct state_struct {
-  int start;                        // 0 until ready to start
-  volatile long counter;            // volatile: always read the value from memory
-  volatile long threads;
-  long num_loops;                   // set in main, not modified in the threads
+// all time computations done in nanoseconds
+#define NS_PER_S	(1000L * 1000 * 1000)
+#ifdef CLOCK_MONOTONIC_RAW
+#define WALL_CLOCK	CLOCK_MONOTONIC_RAW   // not slewed by NTP
+#else
+#define WALL_CLOCK	CLOCK_MONOTONIC
+#endif
+
+/* a point in time: the wall clock, and the CPU time of either the
+ * process or the calling thread, depending on the clock given to now() */
+struct timestamp {
+  long wall_ns;
+  long cpu_ns;
+  clockid_t cpu_clock;              // CLOCK_PROCESS_CPUTIME_ID or CLOCK_THREAD_CPUTIME_ID
 };
 
-/* after busy-waiting for the start variable to be set, increment the
- * state counter variable the given number of times.  Once that
- * is finished, print that we are finished, taking the thread number
- * from the number of threads that haven't finished yet. */
-static void * thread(void * arg)
+/* elapsed wall clock and CPU time between two timestamps */
+struct times {
+  long elapsed_ns;
+  long cpu_ns;
+};
+
+static long clock_ns (clockid_t clock)
 {
-  pthread_mutex_lock(&mainLock);            //aquire main lock to prevent main spinning 
-  
-  
-  if(firstRun){                             //wait for thread lock only on the first run, then destroy it 
-    pthread_mutex_lock(&threadLock);        //used to avoid spinning in threads
-    #ifdef DEBUG
-        printf("{thread:} thread lock aquired\n");
-    #endif 
-    firstRun = 0; 
-    pthread_mutex_destroy(&threadLock);                         //want to destroy the lock here
+  struct timespec ts;
+  clock_gettime (clock, &ts);
+  return ts.tv_sec * NS_PER_S + ts.tv_nsec;
+}
+
+static struct timestamp now (clockid_t cpu_clock)
+{
+  struct timestamp result =
+    { .wall_ns = clock_ns (WALL_CLOCK), .cpu_ns = clock_ns (cpu_clock),
+      .cpu_clock = cpu_clock };
+  return result;
+}
+
+/* compute the elapsed time and the CPU time relative to start, using
+ * the same CPU clock as start.  A thread CPU clock only makes sense
+ * in the thread that took start. */
+static struct times all_times (struct timestamp start)
+{
+  struct timestamp finish = now (start.cpu_clock);
+  struct times result =
+    { .elapsed_ns = finish.wall_ns - start.wall_ns,
+      .cpu_ns = finish.cpu_ns - start.cpu_ns };
+  return result;
+}
+
+/* the number of times the calling thread gave up the CPU itself
+ * (blocking or yielding) and was preempted, or -1 where the system
+ * cannot count them per thread */
+struct context_switches {
+  long voluntary;
+  long involuntary;
+};
+
+static struct context_switches context_switches (void)
+{
+  struct context_switches result = { -1, -1 };
+#ifdef RUSAGE_THREAD
+  struct rusage usage;
+  if (getrusage (RUSAGE_THREAD, &usage) == 0) {
+    result.voluntary = usage.ru_nvcsw;
+    result.involuntary = usage.ru_nivcsw;
   }
-  struct state_struct * state = (struct state_struct *) arg;    //create a state_struct called 'state'. set equal to arg (2nd part is a guess)
-  
-  while (state->start == 0) {                                   //loop until all are ready to start 
-    printf("{thread:} SPINNING\n");
+#endif /* RUSAGE_THREAD */
+  return result;
+}
+
+/* the mutexes whose use can be measured with --lockstats */
+enum { LOCK_COUNT, LOCK_DECRE, LOCK_BARRIER, NUM_LOCKS };
+static const char * lock_names [NUM_LOCKS] = { "countLock", "decreLock", "barrier" };
+
+/* why the transactions of elided mode aborted: locked if countLock was
+ * held by a thread that fell back to it, the others from the abort
+ * status the CPU reports */
+enum { ABORT_LOCKED, ABORT_CONFLICT, ABORT_CAPACITY, ABORT_EXPLICIT, ABORT_DEBUG,
+       ABORT_NESTED, ABORT_OTHER, NUM_ABORTS };
+static const char * abort_names [NUM_ABORTS] =
+  { "locked", "conflict", "capacity", "explicit", "debug", "nested", "other" };
+static const char * abort_fields [NUM_ABORTS] =  // for --json and --csv
+  { "aborts_locked", "aborts_conflict", "aborts_capacity", "aborts_explicit",
+    "aborts_debug", "aborts_nested", "aborts_other" };
+
+/* how one thread used one mutex.  Each thread has its own, so that
+ * keeping the statistics adds no shared cache-line traffic. */
+struct lock_stats {
+  long acquisitions;
+  long contended;                   // acquisitions where trylock failed first
+  long wait_ns;                     // total time from asking for the lock to getting it
+  long max_wait_ns;
+  long hold_ns;                     // total time from getting the lock to releasing it
+  long max_hold_ns;
+  long acquired_ns;                 // when the current hold started
+};
+
+/* lock, recording the wait in stats unless stats is NULL */
+static void stats_lock (pthread_mutex_t * lock, struct lock_stats * stats)
+{
+  if (stats == NULL) {
+    pthread_mutex_lock(lock);
+    return;
   }
-          
-    pthread_cond_wait(&waitCond,&mainLock);                     //first thread to execute will start wait condition 
-    for (int i = 0; i < state->num_loops; i++) {                    
-        pthread_mutex_lock(&countLock);                         //lock only the section where the counter is being updated 
-        state->counter++;
-        pthread_mutex_unlock(&countLock);
+  long start = clock_ns (WALL_CLOCK);
+  if (pthread_mutex_trylock(lock) != 0) {
+    stats->contended++;
+    pthread_mutex_lock(lock);
   }
+  stats->acquired_ns = clock_ns (WALL_CLOCK);
+  long wait = stats->acquired_ns - start;
+  stats->acquisitions++;
+  stats->wait_ns += wait;
+  if (wait > stats->max_wait_ns)
+    stats->max_wait_ns = wait;
+}
 
-  pthread_mutex_unlock(&mainLock);                                   
+/* record in stats, unless NULL, that the hold begun in stats_lock is
+ * over, without unlocking */
+static void stats_end_hold (struct lock_stats * stats)
+{
+  if (stats == NULL)
+    return;
+  long hold = clock_ns (WALL_CLOCK) - stats->acquired_ns;
+  stats->hold_ns += hold;
+  if (hold > stats->max_hold_ns)
+    stats->max_hold_ns = hold;
+}
 
-  //ensure that the state.threads is decremented accurately
-  pthread_mutex_lock(&decreLock); 
-  printf ("thread %ld finishing\n", state->threads);
-  state->threads--; 
-  
-  if( (state->threads) == 0 ){                                  //send a signal on last thread to allow the main thread to continue
-    pthread_cond_signal(&waitCond);
+static void stats_unlock (pthread_mutex_t * lock, struct lock_stats * stats)
+{
+  stats_end_hold (stats);
+  pthread_mutex_unlock(lock);
+}
+
+/* add the statistics from one thread into the total */
+static void add_lock_stats (struct lock_stats * total, const struct lock_stats * add)
+{
+  total->acquisitions += add->acquisitions;
+  total->contended += add->contended;
+  total->wait_ns += add->wait_ns;
+  total->hold_ns += add->hold_ns;
+  if (add->max_wait_ns > total->max_wait_ns)
+    total->max_wait_ns = add->max_wait_ns;
+  if (add->max_hold_ns > total->max_hold_ns)
+    total->max_hold_ns = add->max_hold_ns;
+}
+
+/* a log-linear histogram of times in ns, as in HdrHistogram: values
+ * below 1 << HIST_SUB_BITS have a bucket each, and every larger power
+ * of 2 is split into 1 << HIST_SUB_BITS equal buckets, so a value is
+ * known to within about 3% however large it is */
+#define HIST_SUB	(1 << HIST_SUB_BITS)
+#define HIST_BUCKETS	((64 - HIST_SUB_BITS + 1) * HIST_SUB)
+
+struct histogram {
+  long counts [HIST_BUCKETS];
+  long total;                       // of the counts
+  long max;                         // the largest value added
+};
+
+static int histogram_bucket (long value)
+{
+  if (value < HIST_SUB)
+    return (value < 0) ? 0 : value;
+  int log = 63 - __builtin_clzl (value);                        //>= HIST_SUB_BITS
+  int shift = log - HIST_SUB_BITS;
+  return (shift + 1) * HIST_SUB + ((value >> shift) & (HIST_SUB - 1));
+}
+
+/* the largest value that goes into the bucket */
+static long histogram_value (int bucket)
+{
+  if (bucket < HIST_SUB)
+    return bucket;
+  int shift = bucket / HIST_SUB - 1;
+  long lowest = (long) (HIST_SUB + bucket % HIST_SUB) << shift;
+  return lowest + (1L << shift) - 1;
+}
+
+static void histogram_add (struct histogram * h, long value)
+{
+  h->counts [histogram_bucket (value)]++;
+  h->total++;
+  if (value > h->max)
+    h->max = value;
+}
+
+static void histogram_merge (struct histogram * into, const struct histogram * from)
+{
+  for (int i = 0; i < HIST_BUCKETS; i++)
+    into->counts [i] += from->counts [i];
+  into->total += from->total;
+  if (from->max > into->max)
+    into->max = from->max;
+}
+
+/* the value below which pct percent of the values fall, at most max */
+static long histogram_percentile (const struct histogram * h, double pct)
+{
+  long rank = (long) (pct / 100.0 * h->total + 0.999999);
+  if (rank < 1)
+    rank = 1;
+  long seen = 0;
+  for (int i = 0; i < HIST_BUCKETS; i++) {
+    seen += h->counts [i];
+    if (seen >= rank)
+      return (histogram_value (i) < h->max) ? histogram_value (i) : h->max;
   }
-  pthread_mutex_unlock(&decreLock);
-  return NULL;
+  return h->max;
 }
 
-/* print to a string the elapsed time and the CPU time relative
- * to the start (elapsed time) and startc (CPU time) variables
- *
- * The string returned is in a static array, so if multiple threads
- * call this function at the same, the results may be inaccurate.
- */
+/* print the percentiles, if there are any values */
+static void print_histogram (const char * what, long every, const struct histogram * h)
+{
+  if (h->total == 0)
+    return;
+  printf ("latency of 1 in %ld %s (%ld samples): p50 %ld ns, p90 %ld ns, p99 %ld ns, "
+          "p99.9 %ld ns, max %ld ns\n", every, what, h->total,
+          histogram_percentile (h, 50), histogram_percentile (h, 90),
+          histogram_percentile (h, 99), histogram_percentile (h, 99.9), h->max);
+}
 
-static char * all_times (struct timeval start, clock_t startc)
-{
-// all computations done in microseconds
-#define US_PER_S	(1000 * 1000)
-  struct timeval finish;
-  gettimeofday (&finish, NULL);
-  long delta = (finish.tv_sec - start.tv_sec) * US_PER_S +
-               finish.tv_usec - start.tv_usec;
-  long delta_cpu = (clock() - startc) * US_PER_S / CLOCKS_PER_SEC;
-  static char result [1000];
-  snprintf (result, sizeof (result), "%ld.%06lds, cpu time %ld.%06ld",
-            delta / US_PER_S, delta % US_PER_S,
-            delta_cpu / US_PER_S, delta_cpu % US_PER_S);
-  return result;
+/* --trace: the times in the life of a thread in each trial, kept
+ * apart from the ring of lock waits so that they are never
+ * overwritten.  0 if it did not happen. */
+enum { TRACE_CREATED, TRACE_WOKEN, TRACE_BARRIER, TRACE_STARTED, TRACE_FIRST,
+       TRACE_FINISHED, NUM_TRACE };
+static const char * trace_names [NUM_TRACE] =
+  { "created", "woken", "at start barrier", "started", "first increment", "finished" };
+
+/* a lock acquisition that took at least TRACE_WAIT_NS */
+struct trace_wait {
+  long start_ns;
+  long wait_ns;
+};
+
+/* the trace file, written as each trial finishes and closed at exit,
+ * in the Chrome trace event format that Perfetto also reads */
+struct trace {
+  FILE * file;
+  const char * path;
+  long epoch_ns;                    // wall clock time 0 of the trace
+  int runs;                         // trials written, each as a process of the trace
+  long events;                      // written so far
+  long dropped;                     // lock waits overwritten in the rings
+};
+
+/* the hardware counters that can be collected with --perf.  For
+ * coherence traffic (e.g. HITM loads) the event code depends on the
+ * CPU model, so it must be given as a raw event with --perf-raw. */
+enum { PERF_CYCLES, PERF_INSTRUCTIONS, PERF_CACHE_MISSES, PERF_RAW, NUM_PERF };
+static const char * perf_names [NUM_PERF] = { "cycles", "instructions", "cache misses", "raw" };
+
+/* one thread's counters, opened as a group so that they are all
+ * started and stopped together */
+struct perf_counters {
+  int fds [NUM_PERF];               // -1 if not open
+  long values [NUM_PERF];           // -1 if not counted
+  int error;                        // errno from perf_event_open, or 0
+};
+
+/* open the counters for the calling thread, stopped.  raw is the
+ * config of the raw event, or -1 for none. */
+static void perf_open (struct perf_counters * perf, long raw)
+{
+  for (int i = 0; i < NUM_PERF; i++) {
+    perf->fds [i] = -1;
+    perf->values [i] = -1;
+  }
+  perf->error = 0;
+#ifdef HAVE_PERF
+  static const unsigned long configs [NUM_PERF] =
+    { PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_CACHE_MISSES, 0 };
+  for (int i = 0; i < NUM_PERF; i++) {
+    if ((i == PERF_RAW) && (raw < 0))
+      continue;
+    struct perf_event_attr attr;
+    memset (&attr, 0, sizeof (attr));
+    attr.size = sizeof (attr);
+    attr.type = (i == PERF_RAW) ? PERF_TYPE_RAW : PERF_TYPE_HARDWARE;
+    attr.config = (i == PERF_RAW) ? (unsigned long) raw : configs [i];
+    attr.disabled = (i == PERF_CYCLES);                         //the group leader starts them all
+    attr.exclude_kernel = 1;                                    //allowed with perf_event_paranoid up to 2
+    attr.exclude_hv = 1;
+    perf->fds [i] = syscall (SYS_perf_event_open, &attr, 0, -1, perf->fds [PERF_CYCLES], 0);
+    if (perf->fds [i] < 0) {
+      if (perf->error == 0)
+        perf->error = errno;
+      if (i == PERF_CYCLES)                                     //without a leader there is no group
+        return;
+    }
+  }
+#else
+  (void) raw;
+  perf->error = ENOSYS;
+#endif /* HAVE_PERF */
 }
 
-int main (int argc, char ** argv)
+static void perf_start (struct perf_counters * perf)
 {
-  //initialize the mutex 
-  if (pthread_mutex_init(&countLock, NULL) != 0){
-    printf( "countLock mutex initialization failed\n" );
-    return -1; 
+#ifdef HAVE_PERF
+  if (perf->fds [PERF_CYCLES] >= 0)
+    ioctl (perf->fds [PERF_CYCLES], PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+#else
+  (void) perf;
+#endif /* HAVE_PERF */
+}
+
+/* stop the counters, read them, and close them */
+static void perf_stop (struct perf_counters * perf)
+{
+#ifdef HAVE_PERF
+  if (perf->fds [PERF_CYCLES] >= 0)
+    ioctl (perf->fds [PERF_CYCLES], PERF_EVENT_IOC_DISABLE, PERF_IOC_FLAG_GROUP);
+  for (int i = NUM_PERF - 1; i >= 0; i--) {                     //close the leader last
+    if (perf->fds [i] < 0)
+      continue;
+    long long value;
+    if (read (perf->fds [i], &value, sizeof (value)) == sizeof (value))
+      perf->values [i] = value;
+    close (perf->fds [i]);
+    perf->fds [i] = -1;
   }
-  if (pthread_mutex_init(&decreLock, NULL) != 0){
-    printf( "decreLock mutex initialization failed\n" );
-    return -1; 
+#else
+  (void) perf;
+#endif /* HAVE_PERF */
+}
+
+/* a reusable barrier built from a mutex and a condition variable,
+ * since pthread_barrier_t is not available everywhere (e.g. macOS).
+ * The generation changes each time the barrier opens, so a waiter
+ * can tell its own release apart from a spurious wakeup. */
+struct barrier {
+  pthread_mutex_t lock;
+  pthread_cond_t cond;              //signalled when the last thread arrives
+  long count;                       // number of threads that must arrive
+  long waiting;                     // number arrived so far in this generation
+  unsigned long generation;
+  struct timestamp opened;          // when the barrier last opened, with process CPU time
+};
+
+static int barrier_init (struct barrier * b, long count)
+{
+  if (pthread_mutex_init(&b->lock, NULL) != 0)
+    return -1;
+  if (pthread_cond_init(&b->cond, NULL) != 0) {
+    pthread_mutex_destroy(&b->lock);
+    return -1;
   }
-  if (pthread_mutex_init(&mainLock, NULL) != 0){
-    printf( "mainLock mutex initialization failed\n" );
-    return -1; 
+  b->count = count;
+  b->waiting = 0;
+  b->generation = 0;
+  return 0;
+}
+
+static void barrier_destroy (struct barrier * b)
+{
+  pthread_cond_destroy(&b->cond);
+  pthread_mutex_destroy(&b->lock);
+}
+
+/* block until count threads have called barrier_wait, then release
+ * all of them at once.  If stats is not NULL, the use of the
+ * barrier's mutex is recorded in it, not counting the time spent
+ * waiting for the other threads. */
+static void barrier_wait (struct barrier * b, struct lock_stats * stats)
+{
+  stats_lock(&b->lock, stats);
+  unsigned long generation = b->generation;
+  if (++(b->waiting) == b->count) {                             //last one in opens the barrier
+    b->waiting = 0;
+    b->generation++;
+    b->opened = now (CLOCK_PROCESS_CPUTIME_ID);
+    pthread_cond_broadcast(&b->cond);
+    stats_unlock(&b->lock, stats);
+  } else {
+    stats_end_hold (stats);
+    while (b->generation == generation)
+      pthread_cond_wait(&b->cond, &b->lock);
+    pthread_mutex_unlock(&b->lock);
   }
-  if (pthread_mutex_init(&threadLock, NULL) != 0){
-    printf( "threadLock mutex initialization failed\n" );
-    return -1; 
+}
+
+struct state_struct;
+
+/* rcu mode: an immutable copy of the counter.  Writers publish a new
+ * one, and free the old one once every thread has been seen outside
+ * its read or write since the old one was replaced. */
+struct rcu_snapshot {
+  long value;
+  unsigned long retired;            // value of rcu_epoch when this snapshot was replaced
+  struct rcu_snapshot * next;       // in the retiring thread's list of snapshots to free
+};
+
+/* queue lock nodes: each waiter spins on the locked flag of a node in
+ * its own cache line instead of on the shared lock word */
+struct mcs_node {
+  _Alignas(CACHE_LINE) _Atomic(struct mcs_node *) next;
+  atomic_int locked;                // 1 until the predecessor hands over the lock
+};
+
+struct clh_node {
+  _Alignas(CACHE_LINE) atomic_int locked;      // 1 while the owner holds or waits for the lock
+};
+
+/* cohort mode: the local lock of the threads on one socket, and how
+ * they hold the global lock between them.  global and passes are only
+ * used by the holder of the local lock. */
+struct cohort {
+  _Alignas(CACHE_LINE) _Atomic(struct mcs_node *) tail;
+  int global;                       // 1 while a thread of this cohort holds the global lock
+  long passes;                      // local handoffs since the cohort took the global lock
+};
+
+/* mpmc queue: one slot of the ring, with the sequence number that
+ * tells producers and consumers whose turn it is */
+struct mpmc_cell {
+  atomic_ulong seq;
+  long value;
+};
+
+struct queue_ops;
+
+/* adder mode: one of the cells the counter spreads over once
+ * increments of the base collide, each on its own cache line */
+struct adder_cell {
+  _Alignas(CACHE_LINE) atomic_long value;
+};
+
+/* combining mode: a thread's publication record, on its own cache line
+ * since the combiner reads every thread's record */
+struct fc_record {
+  _Alignas(CACHE_LINE) atomic_long pending;    // the increment waiting to be applied, or 0
+  long taken;                       // only used by the combiner, under fc_lock
+};
+
+/* with --counters, one of the counters and the lock of the striped
+ * mode, padded to a cache line so that neighbouring counters do not
+ * share one */
+struct stripe {
+  _Alignas(CACHE_LINE) atomic_long value;
+  pthread_mutex_t lock;
+};
+
+/* how a thread chooses the counter for each increment */
+enum { PICK_ROUND_ROBIN, PICK_RANDOM, PICK_THREAD };
+static const char * pick_names [] = { "roundrobin", "random", "thread" };
+
+/* one per thread, each on its own cache line so that a thread writing
+ * its own count does not invalidate the line holding another's */
+struct worker {
+  _Alignas(CACHE_LINE) atomic_long count;      // sharded mode: this thread's private slot
+  long id;                          // 0 .. num_threads - 1
+  struct state_struct * state;
+  int cpu;                          // the CPU the thread is pinned to, or -1
+  struct times times;               // of this thread's loop, with thread CPU time
+  struct context_switches switches; // during this thread's loop
+  long start_ns;                    // wall clock time when this thread's loop started
+  long increments;                  // done by this thread
+  long reads;                       // done by this thread, see --read-ratio
+  long read_sum;                    // of the values read, so the reads are not optimized away
+  unsigned long random;             // state of this thread's random number generator
+  long stripe;                      // with --counters, the counter of the current increment
+  atomic_ulong rcu_seen;            // rcu mode: rcu_epoch when this thread was last between operations
+  struct rcu_snapshot * rcu_retired;  // rcu mode: snapshots this thread replaced and has not freed
+  long rcu_num_retired;
+  long rcu_reclaim_at;              // rcu mode: reclaim when rcu_num_retired reaches this
+  struct lock_stats * locks;        // NUM_LOCKS of them if --lockstats, otherwise NULL
+  struct lock_stats lock_stats [NUM_LOCKS];
+  struct perf_counters perf;        // if --perf, the counters of this thread's loop
+  struct mcs_node mcs;              // mcs mode: this thread's queue node
+  struct clh_node clh;              // clh mode: the node this thread started with
+  struct clh_node * clh_mine;       // clh mode: the node this thread enqueues next
+  struct clh_node * clh_pred;       // clh mode: the node this thread waited on
+  long cohort;                      // cohort mode: the index of this thread's socket in cohorts
+  long cohort_acquires;             // cohort mode: times this thread took the global lock
+  long cohort_handoffs;             // cohort mode: times it passed the lock within its socket
+  unsigned long adder_probe;        // adder mode: hash choosing this thread's cell
+  long adder_collisions;            // adder mode: failed compare and swaps of this thread
+  long elide_commits;               // elided mode: critical sections run as transactions
+  long elide_fallbacks;             // elided mode: critical sections run holding countLock
+  long elide_aborts [NUM_ABORTS];   // elided mode: aborted transactions, by reason
+  long trace_ns [NUM_TRACE];        // --trace: when this thread got there, wall clock
+  struct trace_wait * trace_waits;  // --trace: TRACE_EVENTS of them, otherwise NULL
+  long trace_num_waits;             // ever added, the last TRACE_EVENTS are kept
+  struct fc_record fc;              // combining mode: this thread's request
+  long sample_countdown;            // operations until the next one is timed
+  struct histogram latency;         // of the timed operations
+};
+
+/* a synchronization mode: lock and unlock bracket every increment
+ * (by n, the batch size), and read returns the count, either once all
+ * the threads are done or, with --read-ratio, between read_lock and
+ * read_unlock.  Modes that need no lock use no_lock for lock and
+ * unlock.  The remaining members may be NULL: read_lock and
+ * read_unlock then default to lock and unlock, setup and cleanup
+ * are only needed by modes with state to create before the threads
+ * start and remove after they finish, and without loop (or, with
+ * --counters, stripe_loop) the threads run counter_loop with calls
+ * through these pointers. */
+struct sync_ops {
+  const char * name;
+  void (* lock) (struct state_struct * state, struct worker * self);
+  void (* increment) (struct state_struct * state, struct worker * self, long n);
+  void (* unlock) (struct state_struct * state, struct worker * self);
+  long (* read) (struct state_struct * state);
+  void (* read_lock) (struct state_struct * state, struct worker * self);
+  void (* read_unlock) (struct state_struct * state, struct worker * self);
+  int (* setup) (struct state_struct * state);
+  void (* cleanup) (struct state_struct * state);
+  void (* loop) (struct state_struct * state, struct worker * self);  // counter_loop for this mode
+  void (* stripe_loop) (struct state_struct * state, struct worker * self);  // the same with --counters
+};
+
+struct state_struct {
+  struct barrier start_barrier;     // the threads and main wait here before starting
+  /* set in run_trial and only read by the threads, apart from stop,
+   * which main sets once.  Every word the threads write has a cache
+   * line of its own below, so that reading this each round costs no
+   * coherence misses. */
+  _Alignas(CACHE_LINE) long num_loops;  // set in main, not modified in the threads
+  long batch;                       // increments per lock acquisition, set in main
+  const struct sync_ops * ops;      // set in main from --mode, not modified in the threads
+  struct worker * workers;          // num_workers of them, allocated in run_trial
+  long num_workers;
+  int quiet;                        // if set, the threads don't print when finishing
+  int perf;                         // if set, collect hardware counters for the loops
+  long perf_raw;                    // config of the raw hardware counter, or -1
+  int spins;                        // spinpark mode: tries before parking
+  int timed;                        // if set, loop until stop instead of num_loops times
+  atomic_int stop;                  // set by main when a timed run is over
+  int read_percent;                 // percentage of the rounds that read instead of increment
+  struct cohort * cohorts;          // cohort mode: one per socket used, num_cohorts of them
+  long num_cohorts;
+  long cohort_passes;               // cohort mode: most handoffs within a socket in a row
+  _Atomic(struct adder_cell *) * adder_cells;  // adder mode: adder_max of them, the first adder_size created
+  long adder_max;                   // adder mode: the most cells, the CPUs rounded up to a power of 2
+  int elide_rtm;                    // elided mode: if set, the CPU supports transactions
+  long hold_work;                   // --hold, in iterations of busy_work
+  long think_work;                  // --think, in iterations of busy_work
+  atomic_long * hold_buffer;        // --hold-lines, one long in each of hold_lines cache lines
+  long hold_lines;
+  struct stripe * stripes;          // with --counters, num_stripes of them, otherwise 1
+  long num_stripes;
+  int pick;                         // with --counters, how each increment picks its counter
+  struct sync_ops mode;             // *ops with the defaults filled in, see run_trial
+  const struct queue_ops * queue;   // if not NULL, run the queue kernel instead of the counter
+  long producers;                   // queue kernel: threads 0 .. producers - 1 push, the others pop
+  long queue_size;                  // slots in the ring, a power of 2
+  long sample_every;                // time one in this many operations, or 0 for none
+  long * ring;                      // condvar queue: the slots
+  struct mpmc_cell * cells;         // mpmc queue: the slots
+  _Alignas(CACHE_LINE) atomic_long threads;  // not yet finished, decremented with release
+  _Alignas(CACHE_LINE) atomic_long counter;  // the locked modes: only accessed relaxed, the lock orders it
+  _Alignas(CACHE_LINE) atomic_long atomic_counter;  // used instead of counter by the atomic modes
+  _Alignas(CACHE_LINE) atomic_flag spin;  // spinlock mode: set while held
+  _Alignas(CACHE_LINE) atomic_ulong ticket_next;  // ticket mode: next ticket to hand out
+  _Alignas(CACHE_LINE) atomic_ulong ticket_serving;  // ticket mode: ticket allowed into the critical section
+  _Alignas(CACHE_LINE) atomic_int park_word;  // spinpark mode: 0 unlocked, 1 locked, 2 locked with waiters
+  _Alignas(CACHE_LINE) _Atomic(struct mcs_node *) mcs_tail;  // mcs mode: last thread in the queue, or NULL
+  _Alignas(CACHE_LINE) _Atomic(struct clh_node *) clh_tail;  // clh mode: node of the last thread in the queue
+  struct clh_node clh_dummy;        // clh mode: the unlocked node the queue starts with
+  _Alignas(CACHE_LINE) atomic_ulong cohort_next;  // cohort mode: the global ticket lock
+  _Alignas(CACHE_LINE) atomic_ulong cohort_serving;
+  _Alignas(CACHE_LINE) atomic_long adder_size;  // adder mode: cells in use, 0 while only the base is
+  atomic_flag adder_busy;           // adder mode: set while a thread adds cells
+  _Alignas(CACHE_LINE) atomic_int elide_locked;  // elided mode: 1 while a thread holds countLock
+  _Alignas(CACHE_LINE) atomic_ulong seq;  // seqlock mode: odd while a writer is updating atomic_counter
+  _Alignas(CACHE_LINE) _Atomic(struct rcu_snapshot *) rcu_current;  // rcu mode: the latest snapshot
+  _Alignas(CACHE_LINE) atomic_ulong rcu_epoch;  // rcu mode: number of snapshots replaced so far
+  _Alignas(CACHE_LINE) atomic_int fc_lock;  // combining mode: 1 while a thread is combining
+  _Alignas(CACHE_LINE) long ring_head;  // condvar queue: next slot to pop, under ring_lock
+  long ring_count;                  // condvar queue: slots in use, under ring_lock
+  pthread_mutex_t ring_lock;
+  pthread_cond_t ring_not_empty;    //signalled after a push
+  pthread_cond_t ring_not_full;     //signalled after a pop
+  _Alignas(CACHE_LINE) atomic_ulong enqueue_pos;  // mpmc queue: producers' position, own cache line
+  _Alignas(CACHE_LINE) atomic_ulong dequeue_pos;  // mpmc queue: consumers' position, own cache line
+};
+
+/* the lock and unlock functions for each of the modes */
+static void no_lock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  (void) self;
+}
+
+static void mutex_lock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  stats_lock(&countLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void mutex_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  stats_unlock(&countLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void adaptive_lock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  stats_lock(&adaptiveLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void adaptive_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  stats_unlock(&adaptiveLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void rwlock_read_lock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  (void) self;
+  pthread_rwlock_rdlock(&countRwLock);
+}
+
+static void rwlock_write_lock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  (void) self;
+  pthread_rwlock_wrlock(&countRwLock);
+}
+
+static void rwlock_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  (void) self;
+  pthread_rwlock_unlock(&countRwLock);
+}
+
+/* tell the CPU we are spinning, so it can save power and let the
+ * other hyperthread run */
+static inline void cpu_relax (void)
+{
+#if defined(__x86_64__) || defined(__i386__)
+  __builtin_ia32_pause();
+#elif defined(__aarch64__)
+  __asm__ __volatile__ ("yield");
+#endif
+}
+
+static void spin_lock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  while (atomic_flag_test_and_set_explicit(&state->spin, memory_order_acquire))
+    ;                                                           //spin until the holder clears the flag
+}
+
+static void spin_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  atomic_flag_clear_explicit(&state->spin, memory_order_release);
+}
+
+/* yield mode: like spinlock, but give up the CPU instead of spinning,
+ * so that a preempted holder gets to run */
+static void yield_lock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  while (atomic_flag_test_and_set_explicit(&state->spin, memory_order_acquire))
+    sched_yield();
+}
+
+static void ticket_lock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  unsigned long mine = atomic_fetch_add_explicit(&state->ticket_next, 1,
+                                                 memory_order_relaxed);
+  while (atomic_load_explicit(&state->ticket_serving, memory_order_acquire) != mine)
+    cpu_relax();                                                //wait until our number is called
+}
+
+static void ticket_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  unsigned long next = atomic_load_explicit(&state->ticket_serving,
+                                            memory_order_relaxed) + 1;
+  atomic_store_explicit(&state->ticket_serving, next, memory_order_release);
+}
+
+/* sleep until *word is no longer value, or wake up to n threads
+ * sleeping on word.  Without futexes, just yield the CPU. */
+static void park (atomic_int * word, int value)
+{
+#ifdef HAVE_FUTEX
+  syscall (SYS_futex, word, FUTEX_WAIT_PRIVATE, value, NULL, NULL, 0);
+#else
+  (void) word;
+  (void) value;
+  sched_yield();
+#endif /* HAVE_FUTEX */
+}
+
+static void unpark (atomic_int * word, int n)
+{
+#ifdef HAVE_FUTEX
+  syscall (SYS_futex, word, FUTEX_WAKE_PRIVATE, n, NULL, NULL, 0);
+#else
+  (void) word;
+  (void) n;
+#endif /* HAVE_FUTEX */
+}
+
+/* spinpark mode: try state->spins times to get the lock, pausing
+ * twice as long after each failure (up to MAX_BACKOFF pauses), then
+ * sleep in the kernel until the holder wakes us.  The lock word is 2
+ * whenever a thread may be sleeping, so the unlock only makes a
+ * system call if it might be needed.  See Drepper, "Futexes are
+ * tricky". */
+static void spinpark_lock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  int backoff = 1;
+  for (int i = 0; i < state->spins; i++) {
+    int expected = 0;
+    if (atomic_compare_exchange_weak_explicit(&state->park_word, &expected, 1,
+                                              memory_order_acquire, memory_order_relaxed))
+      return;
+    for (int j = 0; j < backoff; j++)
+      cpu_relax();
+    if (backoff < MAX_BACKOFF)
+      backoff *= 2;
   }
+  while (atomic_exchange_explicit(&state->park_word, 2, memory_order_acquire) != 0)
+    park(&state->park_word, 2);
+}
 
-  //create threads 
-  long num_threads = (argc <= 1) ? THREADS : atoi (argv[1]);            //am I true ? if yes : if no //is no arguement #of threads = 2, else it equals user input
-  struct state_struct state =
-    { .start = 0, .counter = 0, .threads = 0,
-      .num_loops = (argc <= 2) ? LOOPS : atoi (argv[2]) };              //10 * 1000 * 1000 unless another argument is specified 
-  
-  //aquire thread lock 
-  pthread_mutex_lock(&threadLock);                   
-  while (state.threads < num_threads) {
-    pthread_t t;
-    pthread_create (&t, NULL, thread, (void *)&state);                  //address = t, start routine = threat() <above>, state is the arguement 
-    state.threads++;                                                    //incease the number of threads in state 
-    #ifdef DEBUG
-        printf("{thread creator}: there are %ld threads\n",state.threads);  
-    #endif
+static void spinpark_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  if (atomic_exchange_explicit(&state->park_word, 0, memory_order_release) == 2)
+    unpark(&state->park_word, 1);
+}
+
+/* mcs mode: Mellor-Crummey and Scott.  A thread appends its node to
+ * the queue and spins on its own flag, which its predecessor clears
+ * when it unlocks. */
+static inline void mcs_acquire (_Atomic(struct mcs_node *) * tail, struct mcs_node * node)
+{
+  atomic_store_explicit(&node->next, NULL, memory_order_relaxed);
+  atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+  struct mcs_node * pred = atomic_exchange_explicit(tail, node, memory_order_acq_rel);
+  if (pred == NULL)                                             //the queue was empty
+    return;
+  atomic_store_explicit(&pred->next, node, memory_order_release);
+  while (atomic_load_explicit(&node->locked, memory_order_acquire))
+    cpu_relax();
+}
+
+static inline void mcs_release (_Atomic(struct mcs_node *) * tail, struct mcs_node * node)
+{
+  struct mcs_node * next = atomic_load_explicit(&node->next, memory_order_acquire);
+  if (next == NULL) {
+    struct mcs_node * expected = node;
+    if (atomic_compare_exchange_strong_explicit(tail, &expected, NULL,
+                                                memory_order_release, memory_order_relaxed))
+      return;                                                   //nobody was waiting
+    while ((next = atomic_load_explicit(&node->next, memory_order_acquire)) == NULL)
+      cpu_relax();                                              //a successor is linking itself in
   }
-  
-  //get time of loop 
-  struct timeval start;
-  gettimeofday (&start, NULL);
-  clock_t startc = clock();
-  state.start = 1;                                                      //start all the threads
-  
-  //release thread lock 
-  #ifdef DEBUG
-    printf("unlocking threadLock\n");
-  #endif 
-  pthread_mutex_unlock(&threadLock);
+  atomic_store_explicit(&next->locked, 0, memory_order_release);
+}
 
+static void mcs_lock (struct state_struct * state, struct worker * self)
+{
+  mcs_acquire (&state->mcs_tail, &(self->mcs));
+}
 
-  sleep(1);                                                             //sleep so the threads can get the lock first 
-  pthread_mutex_lock(&mainLock);                                        //must aquire this lock before moving forward
+static void mcs_unlock (struct state_struct * state, struct worker * self)
+{
+  mcs_release (&state->mcs_tail, &(self->mcs));
+}
 
-  
-  
-  while (state.threads > 0){                                            /* loop until all the threads are done */
-    printf("{main:} SPINNING\n");
-    sleep(1);
+/* clh mode: Craig, Landin and Hagersten.  A thread swaps its node
+ * into the tail and spins on its predecessor's node; on unlock it
+ * takes over the predecessor's node for its next acquisition, since
+ * its own node may still be watched by its successor. */
+static void clh_lock (struct state_struct * state, struct worker * self)
+{
+  struct clh_node * node = self->clh_mine;
+  atomic_store_explicit(&node->locked, 1, memory_order_relaxed);
+  struct clh_node * pred = atomic_exchange_explicit(&state->clh_tail, node,
+                                                     memory_order_acq_rel);
+  while (atomic_load_explicit(&pred->locked, memory_order_acquire))
+    cpu_relax();
+  self->clh_pred = pred;
+}
+
+static void clh_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) state;
+  struct clh_node * node = self->clh_mine;
+  self->clh_mine = self->clh_pred;
+  atomic_store_explicit(&node->locked, 0, memory_order_release);
+}
+
+/* cohort mode: lock cohorting (Dice, Marathe and Shavit), with an mcs
+ * lock for each socket in front of a global ticket lock.  A thread
+ * unlocking passes the lock to the next waiter on its own socket,
+ * which then already holds the global lock, up to cohort_passes times
+ * in a row; otherwise it releases the global lock too, so that the
+ * counter's cache line only moves between sockets once per cohort. */
+static int cohort_setup (struct state_struct * state)
+{
+  state->cohorts = aligned_alloc (CACHE_LINE, state->num_cohorts * sizeof (struct cohort));
+  if (state->cohorts == NULL) {
+    printf( "unable to allocate %ld cohorts\n", state->num_cohorts );
+    return -1;
   }
+  for (long i = 0; i < state->num_cohorts; i++)
+    state->cohorts [i] = (struct cohort) { .tail = NULL, .global = 0, .passes = 0 };
+  return 0;
+}
 
-  printf ("%ld total count, expected %ld, time %ss\n",
-          state.counter, state.num_loops * num_threads,
-          all_times (start, startc));
+static void cohort_cleanup (struct state_struct * state)
+{
+  free (state->cohorts);
+}
 
-  pthread_mutex_destroy(&mainLock);                                      //destroy this lock 
+static void cohort_lock (struct state_struct * state, struct worker * self)
+{
+  struct cohort * c = &(state->cohorts [self->cohort]);
+  mcs_acquire (&c->tail, &(self->mcs));
+  if (c->global)                                                //passed on by a thread of this socket
+    return;
+  unsigned long mine = atomic_fetch_add_explicit(&state->cohort_next, 1,
+                                                 memory_order_relaxed);
+  while (atomic_load_explicit(&state->cohort_serving, memory_order_acquire) != mine)
+    cpu_relax();
+  c->global = 1;
+  c->passes = 0;
+  self->cohort_acquires++;
+}
 
-  #ifdef DEBUG
-    printf("end of program\n");
-  #endif 
-  return 0; 
-}
\ No newline at end of file
+static void cohort_unlock (struct state_struct * state, struct worker * self)
+{
+  struct cohort * c = &(state->cohorts [self->cohort]);
+  if ((c->passes < state->cohort_passes) &&
+      (atomic_load_explicit(&c->tail, memory_order_relaxed) != &(self->mcs))) {
+    c->passes++;                                                //a thread of this socket is waiting
+    self->cohort_handoffs++;
+    mcs_release (&c->tail, &(self->mcs));
+    return;
+  }
+  c->global = 0;
+  unsigned long next = atomic_load_explicit(&state->cohort_serving,
+                                            memory_order_relaxed) + 1;
+  atomic_store_explicit(&state->cohort_serving, next, memory_order_release);
+  mcs_release (&c->tail, &(self->mcs));
+}
+
+/* elided mode: lock elision with Intel's restricted transactional
+ * memory.  The critical section runs as a transaction that only reads
+ * elide_locked, so threads incrementing at the same time only abort
+ * if they conflict on the counter itself, not on a lock word.  After
+ * an abort that would happen again (or ELIDE_TRIES of them), the
+ * thread takes countLock and sets elide_locked, which aborts every
+ * transaction in progress.  Without RTM every critical section takes
+ * countLock. */
+static int rtm_available (void)
+{
+#ifdef HAVE_RTM
+  unsigned int eax, ebx, ecx, edx;
+  if (! __get_cpuid_count (7, 0, &eax, &ebx, &ecx, &edx))
+    return 0;
+  return ((ebx & bit_RTM) != 0) && ((edx & (1 << 11)) == 0);   //and not RTM_ALWAYS_ABORT
+#else
+  return 0;
+#endif /* HAVE_RTM */
+}
+
+static int elided_setup (struct state_struct * state)
+{
+  state->elide_rtm = rtm_available ();
+  atomic_init(&state->elide_locked, 0);
+  return 0;
+}
+
+#ifdef HAVE_RTM
+#define ELIDE_LOCKED_CODE	0xff    // _xabort code when elide_locked is set
+
+static int abort_reason (unsigned int status)
+{
+  if (status & _XABORT_EXPLICIT)
+    return (_XABORT_CODE (status) == ELIDE_LOCKED_CODE) ? ABORT_LOCKED : ABORT_EXPLICIT;
+  if (status & _XABORT_CONFLICT)
+    return ABORT_CONFLICT;
+  if (status & _XABORT_CAPACITY)
+    return ABORT_CAPACITY;
+  if (status & _XABORT_DEBUG)
+    return ABORT_DEBUG;
+  if (status & _XABORT_NESTED)
+    return ABORT_NESTED;
+  return ABORT_OTHER;                                           //e.g. an interrupt or a page fault
+}
+#endif /* HAVE_RTM */
+
+/* the retries after the first transaction aborted with status, and the
+ * fallback to countLock, out of line so that the first try inlines
+ * into the loop.  A transaction started here stays active after it
+ * returns, until elided_unlock ends it. */
+static RTM_TARGET __attribute__ ((noinline))
+void elided_lock_slow (struct state_struct * state, struct worker * self, unsigned int status)
+{
+#ifdef HAVE_RTM
+  for (int i = 1; state->elide_rtm; i++) {
+    int reason = abort_reason (status);
+    self->elide_aborts [reason]++;
+    if (reason == ABORT_LOCKED) {
+      while (atomic_load_explicit(&state->elide_locked, memory_order_relaxed))
+        cpu_relax();                                            //try again once countLock is free
+    } else if ((status & _XABORT_RETRY) == 0) {
+      break;                                                    //would abort again
+    }
+    if (i >= ELIDE_TRIES)
+      break;
+    status = _xbegin ();
+    if (status == _XBEGIN_STARTED) {
+      if (atomic_load_explicit(&state->elide_locked, memory_order_relaxed) == 0)
+        return;                                                 //in a transaction until the unlock
+      _xabort (ELIDE_LOCKED_CODE);
+    }
+  }
+#else
+  (void) status;
+#endif /* HAVE_RTM */
+  stats_lock(&countLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+  atomic_store(&state->elide_locked, 1);                       //seq_cst: before this thread reads the counter
+  self->elide_fallbacks++;
+}
+
+static RTM_TARGET __attribute__ ((noinline))
+void elided_unlock_slow (struct state_struct * state, struct worker * self)
+{
+  atomic_store_explicit(&state->elide_locked, 0, memory_order_release);
+  stats_unlock(&countLock, self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static inline RTM_TARGET void elided_lock (struct state_struct * state, struct worker * self)
+{
+  unsigned int status = 0;
+#ifdef HAVE_RTM
+  if (state->elide_rtm) {
+    status = _xbegin ();
+    if (status == _XBEGIN_STARTED) {
+      if (atomic_load_explicit(&state->elide_locked, memory_order_relaxed) == 0)
+        return;                                                 //in a transaction until the unlock
+      _xabort (ELIDE_LOCKED_CODE);
+    }
+  }
+#endif /* HAVE_RTM */
+  elided_lock_slow (state, self, status);
+}
+
+static inline RTM_TARGET void elided_unlock (struct state_struct * state, struct worker * self)
+{
+#ifdef HAVE_RTM
+  if (state->elide_rtm && _xtest ()) {
+    _xend ();
+    self->elide_commits++;
+    return;
+  }
+#endif /* HAVE_RTM */
+  elided_unlock_slow (state, self);
+}
+
+/* seqlock mode: a writer makes seq odd while it updates the counter,
+ * and a reader retries until it sees the same even seq before and
+ * after reading.  Readers never write to shared memory.  Writers
+ * exclude each other with seq itself, not with countLock; the acquire
+ * CAS orders a writer after the previous one, and the release fence
+ * keeps its counter store from becoming visible before the odd seq
+ * (Boehm, "Can seqlocks get along with programming language memory
+ * models?"). */
+static void seqlock_lock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  unsigned long seq = atomic_load_explicit(&state->seq, memory_order_relaxed);
+  while ((seq & 1) ||
+         ! atomic_compare_exchange_weak_explicit(&state->seq, &seq, seq + 1,
+                                                 memory_order_acquire, memory_order_relaxed)) {
+    cpu_relax();
+    seq = atomic_load_explicit(&state->seq, memory_order_relaxed);
+  }
+  atomic_thread_fence(memory_order_release);                    //the odd seq before the counter store
+}
+
+static void seqlock_unlock (struct state_struct * state, struct worker * self)
+{
+  (void) self;
+  atomic_fetch_add_explicit(&state->seq, 1, memory_order_release);
+}
+
+static void seqlock_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) self;
+  long value = atomic_load_explicit(&state->atomic_counter, memory_order_relaxed);
+  atomic_store_explicit(&state->atomic_counter, value + n, memory_order_relaxed);
+}
+
+static long seqlock_read (struct state_struct * state)
+{
+  unsigned long before, after;
+  long value;
+  do {
+    before = atomic_load_explicit(&state->seq, memory_order_acquire);
+    value = atomic_load_explicit(&state->atomic_counter, memory_order_relaxed);
+    atomic_thread_fence(memory_order_acquire);
+    after = atomic_load_explicit(&state->seq, memory_order_relaxed);
+  } while ((before & 1) || (before != after));
+  return value;
+}
+
+/* rcu mode: readers just follow the current snapshot pointer.  Writers,
+ * serialized by countLock, publish a copy with the new value and put
+ * the old one on their retired list.  Every thread records the epoch
+ * in rcu_seen whenever it is between operations (a quiescent state),
+ * so a snapshot retired in epoch e can be freed once every thread has
+ * seen epoch e: nobody can still be reading it. */
+#define RCU_RECLAIM	64                  // retired snapshots that trigger a reclaim
+
+static int rcu_setup (struct state_struct * state)
+{
+  struct rcu_snapshot * first = malloc (sizeof (struct rcu_snapshot));
+  if (first == NULL) {
+    printf ("unable to allocate the first rcu snapshot\n");
+    return -1;
+  }
+  first->value = 0;
+  atomic_store(&state->rcu_current, first);
+  return 0;
+}
+
+static void rcu_quiescent (struct state_struct * state, struct worker * self)
+{
+  atomic_store_explicit(&self->rcu_seen, atomic_load(&state->rcu_epoch),
+                        memory_order_release);
+}
+
+/* free the snapshots this thread retired that nobody can be reading */
+static void rcu_reclaim (struct state_struct * state, struct worker * self)
+{
+  unsigned long oldest = ULONG_MAX;
+  for (long i = 0; i < state->num_workers; i++) {
+    unsigned long seen = atomic_load_explicit(&state->workers [i].rcu_seen,
+                                              memory_order_acquire);
+    if (seen < oldest)
+      oldest = seen;
+  }
+  struct rcu_snapshot ** link = &(self->rcu_retired);
+  while (*link != NULL) {
+    struct rcu_snapshot * old = *link;
+    if (old->retired <= oldest) {
+      *link = old->next;
+      free (old);
+      self->rcu_num_retired--;
+    } else {
+      link = &(old->next);
+    }
+  }
+}
+
+static void rcu_increment (struct state_struct * state, struct worker * self, long n)
+{
+  struct rcu_snapshot * old = atomic_load_explicit(&state->rcu_current, memory_order_relaxed);
+  struct rcu_snapshot * new = malloc (sizeof (struct rcu_snapshot));
+  if (new == NULL) {
+    printf ("unable to allocate an rcu snapshot\n");
+    exit (-1);
+  }
+  new->value = old->value + n;
+  atomic_store_explicit(&state->rcu_current, new, memory_order_release);
+  old->retired = atomic_fetch_add(&state->rcu_epoch, 1) + 1;
+  old->next = self->rcu_retired;
+  self->rcu_retired = old;
+  if (++(self->rcu_num_retired) >= self->rcu_reclaim_at) {
+    rcu_reclaim(state, self);                                     //a preempted reader can hold many back,
+    self->rcu_reclaim_at = self->rcu_num_retired + RCU_RECLAIM;   //so do not rescan them every increment
+  }
+}
+
+static void rcu_unlock (struct state_struct * state, struct worker * self)
+{
+  mutex_unlock(state, self);
+  rcu_quiescent(state, self);
+}
+
+static long rcu_read (struct state_struct * state)
+{
+  return atomic_load_explicit(&state->rcu_current, memory_order_acquire)->value;
+}
+
+/* after the threads are done, nobody is reading any snapshot */
+static void rcu_cleanup (struct state_struct * state)
+{
+  for (long i = 0; i < state->num_workers; i++) {
+    struct rcu_snapshot * old = state->workers [i].rcu_retired;
+    while (old != NULL) {
+      struct rcu_snapshot * next = old->next;
+      free (old);
+      old = next;
+    }
+  }
+  free (atomic_load(&state->rcu_current));
+}
+
+/* combining mode (flat combining): a thread publishes its increment in
+ * its record, and whichever thread gets fc_lock adds up all the
+ * published increments, applies them to the counter at once, and only
+ * then clears the records, releasing their owners.  The others wait
+ * for their record to be cleared, or for the lock to be free so they
+ * can combine themselves.  Under contention, one thread does a batch
+ * of increments with the counter's cache line in its own cache. */
+static void fc_increment (struct state_struct * state, struct worker * self, long n)
+{
+  atomic_store_explicit(&self->fc.pending, n, memory_order_release);
+  for (;;) {
+    if (! atomic_load_explicit(&state->fc_lock, memory_order_relaxed) &&
+        ! atomic_exchange_explicit(&state->fc_lock, 1, memory_order_acquire)) {
+      long sum = 0;
+      for (long i = 0; i < state->num_workers; i++) {
+        struct fc_record * r = &(state->workers [i].fc);
+        r->taken = atomic_load_explicit(&r->pending, memory_order_acquire);
+        sum += r->taken;
+      }
+      long value = atomic_load_explicit(&state->counter, memory_order_relaxed);
+      atomic_store_explicit(&state->counter, value + sum, memory_order_relaxed);
+      for (long i = 0; i < state->num_workers; i++) {
+        struct fc_record * r = &(state->workers [i].fc);
+        if (r->taken != 0)                                      //not those published since
+          atomic_store_explicit(&r->pending, 0, memory_order_release);
+      }
+      atomic_store_explicit(&state->fc_lock, 0, memory_order_release);
+      return;                                                   //this thread's was one of them
+    }
+    while ((atomic_load_explicit(&self->fc.pending, memory_order_relaxed) != 0) &&
+           atomic_load_explicit(&state->fc_lock, memory_order_relaxed))
+      cpu_relax();
+    if (atomic_load_explicit(&self->fc.pending, memory_order_acquire) == 0)
+      return;                                                   //another thread applied it
+  }
+}
+
+/* the increment and read functions: plain for the locked (and racy)
+ * modes, atomic read-modify-writes for the others.  The plain ones
+ * are a separate relaxed load and store, which costs the same as an
+ * ordinary variable but is still defined when mode none races.  The
+ * atomic modes differ only in the memory order, seq_cst for atomic,
+ * acq_rel (and acquire for reads) for acqrel and relaxed for relaxed,
+ * to show what the ordering costs: nothing on x86, where every
+ * read-modify-write is a full barrier, but possibly more elsewhere. */
+static void plain_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) self;
+  long value = atomic_load_explicit(&state->counter, memory_order_relaxed);
+  atomic_store_explicit(&state->counter, value + n, memory_order_relaxed);
+}
+
+static long plain_read (struct state_struct * state)
+{
+  return atomic_load_explicit(&state->counter, memory_order_relaxed);
+}
+
+static void atomic_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) self;
+  atomic_fetch_add_explicit(&state->atomic_counter, n, memory_order_seq_cst);
+}
+
+static void acqrel_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) self;
+  atomic_fetch_add_explicit(&state->atomic_counter, n, memory_order_acq_rel);
+}
+
+static void relaxed_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) self;
+  atomic_fetch_add_explicit(&state->atomic_counter, n, memory_order_relaxed);
+}
+
+static long atomic_read (struct state_struct * state)
+{
+  return atomic_load_explicit(&state->atomic_counter, memory_order_seq_cst);
+}
+
+static long acquire_read (struct state_struct * state)
+{
+  return atomic_load_explicit(&state->atomic_counter, memory_order_acquire);
+}
+
+static long relaxed_read (struct state_struct * state)
+{
+  return atomic_load_explicit(&state->atomic_counter, memory_order_relaxed);
+}
+
+/* sharded mode: each thread only touches its own slot, and the slots
+ * are added up after all the threads are done */
+static void sharded_increment (struct state_struct * state, struct worker * self, long n)
+{
+  (void) state;
+  long count = atomic_load_explicit(&self->count, memory_order_relaxed);     //only this thread writes it
+  atomic_store_explicit(&self->count, count + n, memory_order_relaxed);
+}
+
+static long sharded_read (struct state_struct * state)
+{
+  long sum = 0;
+  for (long i = 0; i < state->num_workers; i++)
+    sum += atomic_load_explicit(&state->workers [i].count, memory_order_relaxed);
+  return sum;
+}
+
+/* adder mode: a counter like Java's LongAdder.  It starts as just
+ * the base, atomic_counter, updated by compare and swap; a thread whose
+ * compare and swap fails doubles the number of cells (up to adder_max,
+ * as more cells than CPUs cannot be contended), moves to another cell
+ * and tries again.  Cells are only allocated when they are first
+ * needed, so a counter without contention costs one long, and once
+ * published they are never removed.  Readers add up the base and every
+ * cell in use. */
+static int adder_setup (struct state_struct * state)
+{
+  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  state->adder_max = 1;
+  while (state->adder_max < cpus)
+    state->adder_max *= 2;
+  state->adder_cells = calloc (state->adder_max, sizeof (struct adder_cell *));
+  if (state->adder_cells == NULL) {
+    printf( "unable to allocate %ld adder cells\n", state->adder_max );
+    return -1;
+  }
+  atomic_init(&state->adder_size, 0);
+  atomic_flag_clear(&state->adder_busy);
+  return 0;
+}
+
+static void adder_cleanup (struct state_struct * state)
+{
+  for (long i = 0; i < state->adder_max; i++)
+    free (state->adder_cells [i]);                              //NULL for the cells never needed
+  free (state->adder_cells);
+}
+
+/* add cells after the first size, unless another thread is already
+ * doing that or has done it.  If a cell cannot be allocated, the
+ * counter just stays smaller. */
+static void adder_grow (struct state_struct * state, long size)
+{
+  if (atomic_flag_test_and_set_explicit(&state->adder_busy, memory_order_acquire))
+    return;
+  if ((atomic_load_explicit(&state->adder_size, memory_order_relaxed) == size) &&
+      (size < state->adder_max)) {
+    long grown = (size == 0) ? 2 : 2 * size;
+    if (grown > state->adder_max)
+      grown = state->adder_max;
+    for (long i = size; i < grown; i++) {
+      if (state->adder_cells [i] == NULL)
+        state->adder_cells [i] = aligned_alloc (CACHE_LINE, sizeof (struct adder_cell));
+      if (state->adder_cells [i] == NULL) {
+        grown = i;
+        break;
+      }
+      atomic_init(&state->adder_cells [i]->value, 0);
+    }
+    atomic_store_explicit(&state->adder_size, grown, memory_order_release);  //publishes the new cells
+  }
+  atomic_flag_clear_explicit(&state->adder_busy, memory_order_release);
+}
+
+static void adder_increment (struct state_struct * state, struct worker * self, long n)
+{
+  for (;;) {
+    long size = atomic_load_explicit(&state->adder_size, memory_order_acquire);
+    atomic_long * target = (size == 0) ? &state->atomic_counter :
+                           &(atomic_load_explicit(&state->adder_cells [self->adder_probe & (size - 1)],
+                                                  memory_order_relaxed)->value);
+    long value = atomic_load_explicit(target, memory_order_relaxed);
+    if (atomic_compare_exchange_strong_explicit(target, &value, value + n,
+                                                memory_order_relaxed, memory_order_relaxed))
+      return;
+    self->adder_collisions++;                                   //contended: spread out further
+    adder_grow (state, size);
+    unsigned long x = self->adder_probe;
+    x ^= x << 13;
+    x ^= x >> 7;
+    x ^= x << 17;
+    self->adder_probe = x;
+  }
+}
+
+static long adder_read (struct state_struct * state)
+{
+  long sum = atomic_load_explicit(&state->atomic_counter, memory_order_relaxed);
+  long size = atomic_load_explicit(&state->adder_size, memory_order_acquire);
+  for (long i = 0; i < size; i++)
+    sum += atomic_load_explicit(&(atomic_load_explicit(&state->adder_cells [i],
+                                                       memory_order_relaxed)->value),
+                                memory_order_relaxed);
+  return sum;
+}
+
+/* with --counters, the locked modes and none update one of the
+ * stripes instead of counter, and the striped mode also locks just
+ * that one.  Readers add up all of them, under the mode's lock, or
+ * without one in striped mode, which is safe since each is atomic but
+ * may mix values from before and after concurrent increments. */
+static void stripe_lock (struct state_struct * state, struct worker * self)
+{
+  stats_lock(&(state->stripes [self->stripe].lock),
+             self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void stripe_unlock (struct state_struct * state, struct worker * self)
+{
+  stats_unlock(&(state->stripes [self->stripe].lock),
+               self->locks ? &(self->locks [LOCK_COUNT]) : NULL);
+}
+
+static void stripe_increment (struct state_struct * state, struct worker * self, long n)
+{
+  atomic_long * value = &(state->stripes [self->stripe].value);
+  atomic_store_explicit(value, atomic_load_explicit(value, memory_order_relaxed) + n,
+                        memory_order_relaxed);
+}
+
+static long stripe_read (struct state_struct * state)
+{
+  long sum = 0;
+  for (long i = 0; i < state->num_stripes; i++)
+    sum += atomic_load_explicit(&state->stripes [i].value, memory_order_relaxed);
+  return sum;
+}
+
+/* --trace: record the first increment, and the lock acquisition begun
+ * at started if it had to wait */
+static __attribute__ ((noinline)) void trace_acquired (struct worker * self, long started)
+{
+  long acquired = clock_ns (WALL_CLOCK);
+  if (self->trace_ns [TRACE_FIRST] == 0)
+    self->trace_ns [TRACE_FIRST] = acquired;
+  if (acquired - started < TRACE_WAIT_NS)
+    return;
+  struct trace_wait * w = &(self->trace_waits [self->trace_num_waits++ % TRACE_EVENTS]);
+  w->start_ns = started;
+  w->wait_ns = acquired - started;
+}
+
+/* the next number from this thread's xorshift generator */
+static unsigned long next_random (struct worker * self)
+{
+  unsigned long x = self->random;
+  x ^= x << 13;
+  x ^= x >> 7;
+  x ^= x << 17;
+  self->random = x;
+  return x;
+}
+
+/* spin for the given number of iterations, without touching memory */
+static inline void busy_work (long iterations)
+{
+  for (long i = 0; i < iterations; i++)
+    atomic_signal_fence(memory_order_seq_cst);                  //keeps the compiler from removing the loop
+}
+
+/* the number of busy_work iterations per ns, measured the first time */
+static double busy_work_per_ns (void)
+{
+  static double per_ns = 0.0;
+  if (per_ns == 0.0) {
+    long iterations = 10 * 1000 * 1000;
+    struct timestamp start = now (CLOCK_THREAD_CPUTIME_ID);
+    busy_work (iterations);
+    struct times times = all_times (start);
+    per_ns = (times.elapsed_ns > 0) ? (double) iterations / times.elapsed_ns : 1.0;
+  }
+  return per_ns;
+}
+
+/* the part of state the loop of a thread reads each round, copied
+ * into a local by counter_loop: the compiler can't keep the fields of
+ * state in registers across the calls to the lock functions, which
+ * might change them, and would reload them in every round */
+struct round_config {
+  long num_loops;
+  long batch;
+  int timed;
+  int read_percent;
+  long num_stripes;
+  int pick;
+  long sample_every;
+  long hold_work;
+  long hold_lines;
+  atomic_long * hold_buffer;
+  long think_work;
+};
+
+/* the work done while holding the lock, besides the increment: with
+ * --hold, spin, and with --hold-lines, write (or, for a reader, read)
+ * one long in each of the shared buffer's cache lines, so that they
+ * move between the caches of the threads along with the lock */
+static inline void hold_work (const struct round_config * config, struct worker * self, int write)
+{
+  busy_work (config->hold_work);
+  for (long i = 0; i < config->hold_lines; i++) {
+    atomic_long * line = &(config->hold_buffer [i * (CACHE_LINE / sizeof (long))]);
+    long value = atomic_load_explicit(line, memory_order_relaxed);
+    if (write)
+      atomic_store_explicit(line, value + 1, memory_order_relaxed);
+    else
+      self->read_sum += value;
+  }
+}
+
+/* one round of the loop: read the counter with probability
+ * config->read_percent, otherwise increment it by n.  Returns the
+ * number of increments done. */
+static inline __attribute__ ((always_inline))
+long one_round (struct state_struct * state, struct worker * self,
+                const struct sync_ops * ops, const struct round_config * config, long n)
+{
+  if ((config->read_percent > 0) && ((long) (next_random(self) % 100) < config->read_percent)) {
+    ops->read_lock(state, self);
+    self->read_sum += ops->read(state);
+    hold_work (config, self, 0);
+    ops->read_unlock(state, self);
+    busy_work (config->think_work);
+    self->reads++;
+    return 0;
+  }
+  if (config->num_stripes > 1) {
+    if (config->pick == PICK_ROUND_ROBIN)
+      self->stripe = (self->stripe + 1 < config->num_stripes) ? self->stripe + 1 : 0;
+    else if (config->pick == PICK_RANDOM)
+      self->stripe = next_random(self) % config->num_stripes;
+  }
+  long started = 0;
+  int sample = (config->sample_every > 0) && (--(self->sample_countdown) == 0);
+  if (sample || (self->trace_waits != NULL))
+    started = clock_ns (WALL_CLOCK);
+  ops->lock(state, self);                                       //lock only the section where the counter is being updated 
+  if (self->trace_waits != NULL)
+    trace_acquired (self, started);
+  ops->increment(state, self, n);
+  if (sample) {                                                 //the time to get the lock and increment
+    histogram_add (&self->latency, clock_ns (WALL_CLOCK) - started);
+    self->sample_countdown = config->sample_every;
+  }
+  hold_work (config, self, 1);
+  ops->unlock(state, self);
+  busy_work (config->think_work);                                //the work between acquisitions
+  return n;
+}
+
+/* the loop of a thread in the counter kernel: num_loops increments,
+ * state->batch per round (the last round may do fewer), or in a timed
+ * run rounds of state->batch until main sets state->stop.  It is
+ * inlined into a loop for each mode below, where ops is a constant and
+ * the mode's functions are inlined too, so that the measurement of
+ * cheap modes doesn't include an indirect call per increment; the
+ * threads only call it with their copy of the mode when --indirect
+ * is given. */
+static inline __attribute__ ((always_inline))
+void counter_loop (struct state_struct * state, struct worker * self,
+                   const struct sync_ops * ops)
+{
+  const struct round_config config = {
+    .num_loops = state->num_loops,
+    .batch = state->batch,
+    .timed = state->timed,
+    .read_percent = state->read_percent,
+    .num_stripes = state->num_stripes,
+    .pick = state->pick,
+    .sample_every = state->sample_every,
+    .hold_work = state->hold_work,
+    .hold_lines = state->hold_lines,
+    .hold_buffer = state->hold_buffer,
+    .think_work = state->think_work,
+  };
+  long done = 0;
+  if (config.timed) {
+    while (! atomic_load_explicit(&state->stop, memory_order_relaxed))
+      done += one_round(state, self, ops, &config, config.batch);
+  } else {
+    for (long i = 0; i < config.num_loops; i += config.batch) {
+      long n = config.num_loops - i;                            //the remainder, on the last round
+      if (n > config.batch)
+        n = config.batch;
+      done += one_round(state, self, ops, &config, n);
+    }
+  }
+  self->increments = done;
+}
+
+/* define loop as counter_loop specialized for a mode's functions,
+ * with the function attributes they need to be inlined (RTM_TARGET) */
+#define TARGETED_LOOP(attributes, loop, lock, increment, unlock, read, read_lock, read_unlock) \
+  static attributes void loop (struct state_struct * state, struct worker * self)   \
+  {                                                                                 \
+    static const struct sync_ops ops =                                              \
+      { #loop, lock, increment, unlock, read, read_lock, read_unlock, NULL, NULL, NULL, NULL }; \
+    counter_loop (state, self, &ops);                                               \
+  }
+#define SPECIALIZED_LOOP(...)	TARGETED_LOOP (, __VA_ARGS__)
+
+/* define name_loop for a locked mode, and name_stripe_loop, the same
+ * for --counters, which updates and reads the stripes instead */
+#define TARGETED_LOCKED_LOOPS(attributes, name, lock, unlock, read_lock, read_unlock) \
+  TARGETED_LOOP (attributes, name##_loop, lock, plain_increment, unlock, plain_read, \
+                 read_lock, read_unlock)                                            \
+  TARGETED_LOOP (attributes, name##_stripe_loop, lock, stripe_increment, unlock,    \
+                 stripe_read, read_lock, read_unlock)
+#define LOCKED_LOOPS(...)	TARGETED_LOCKED_LOOPS (, __VA_ARGS__)
+
+LOCKED_LOOPS (mutex, mutex_lock, mutex_unlock, mutex_lock, mutex_unlock)
+LOCKED_LOOPS (adaptive, adaptive_lock, adaptive_unlock, adaptive_lock, adaptive_unlock)
+LOCKED_LOOPS (spinpark, spinpark_lock, spinpark_unlock, spinpark_lock, spinpark_unlock)
+LOCKED_LOOPS (rwlock, rwlock_write_lock, rwlock_unlock, rwlock_read_lock, rwlock_unlock)
+SPECIALIZED_LOOP (seqlock_loop, seqlock_lock, seqlock_increment, seqlock_unlock, seqlock_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (rcu_loop, mutex_lock, rcu_increment, rcu_unlock, rcu_read,
+                  no_lock, rcu_quiescent)
+LOCKED_LOOPS (spinlock, spin_lock, spin_unlock, spin_lock, spin_unlock)
+LOCKED_LOOPS (yield, yield_lock, spin_unlock, yield_lock, spin_unlock)
+SPECIALIZED_LOOP (atomic_loop, no_lock, atomic_increment, no_lock, atomic_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (acqrel_loop, no_lock, acqrel_increment, no_lock, acquire_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (relaxed_loop, no_lock, relaxed_increment, no_lock, relaxed_read,
+                  no_lock, no_lock)
+LOCKED_LOOPS (ticket, ticket_lock, ticket_unlock, ticket_lock, ticket_unlock)
+LOCKED_LOOPS (mcs, mcs_lock, mcs_unlock, mcs_lock, mcs_unlock)
+LOCKED_LOOPS (clh, clh_lock, clh_unlock, clh_lock, clh_unlock)
+LOCKED_LOOPS (cohort, cohort_lock, cohort_unlock, cohort_lock, cohort_unlock)
+TARGETED_LOCKED_LOOPS (RTM_TARGET, elided, elided_lock, elided_unlock, elided_lock, elided_unlock)
+SPECIALIZED_LOOP (combining_loop, no_lock, fc_increment, no_lock, plain_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (striped_loop, stripe_lock, stripe_increment, stripe_unlock, stripe_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (sharded_loop, no_lock, sharded_increment, no_lock, sharded_read,
+                  no_lock, no_lock)
+SPECIALIZED_LOOP (adder_loop, no_lock, adder_increment, no_lock, adder_read,
+                  no_lock, no_lock)
+LOCKED_LOOPS (none, no_lock, no_lock, no_lock, no_lock)
+
+static const struct sync_ops modes [] = {
+  { "mutex",    mutex_lock,  plain_increment,   mutex_unlock,  plain_read,
+                NULL,        NULL,              NULL, NULL, mutex_loop,
+                mutex_stripe_loop },
+  { "adaptive", adaptive_lock, plain_increment, adaptive_unlock, plain_read,
+                NULL,        NULL,              NULL, NULL, adaptive_loop,
+                adaptive_stripe_loop },
+  { "spinpark", spinpark_lock, plain_increment, spinpark_unlock, plain_read,
+                NULL,        NULL,              NULL, NULL, spinpark_loop,
+                spinpark_stripe_loop },
+  { "rwlock",   rwlock_write_lock, plain_increment, rwlock_unlock, plain_read,
+                rwlock_read_lock, rwlock_unlock, NULL, NULL, rwlock_loop,
+                rwlock_stripe_loop },
+  { "seqlock",  seqlock_lock, seqlock_increment, seqlock_unlock, seqlock_read,
+                no_lock,     no_lock,           NULL, NULL, seqlock_loop, NULL },
+  { "rcu",      mutex_lock,  rcu_increment,     rcu_unlock,    rcu_read,
+                no_lock,     rcu_quiescent,     rcu_setup, rcu_cleanup, rcu_loop, NULL },
+  { "spinlock", spin_lock,   plain_increment,   spin_unlock,   plain_read,
+                NULL,        NULL,              NULL, NULL, spinlock_loop,
+                spinlock_stripe_loop },
+  { "yield",    yield_lock,  plain_increment,   spin_unlock,   plain_read,
+                NULL,        NULL,              NULL, NULL, yield_loop,
+                yield_stripe_loop },
+  { "atomic",   no_lock,     atomic_increment,  no_lock,       atomic_read,
+                NULL,        NULL,              NULL, NULL, atomic_loop, NULL },
+  { "acqrel",   no_lock,     acqrel_increment,  no_lock,       acquire_read,
+                NULL,        NULL,              NULL, NULL, acqrel_loop, NULL },
+  { "relaxed",  no_lock,     relaxed_increment, no_lock,       relaxed_read,
+                NULL,        NULL,              NULL, NULL, relaxed_loop, NULL },
+  { "ticket",   ticket_lock, plain_increment,   ticket_unlock, plain_read,
+                NULL,        NULL,              NULL, NULL, ticket_loop,
+                ticket_stripe_loop },
+  { "mcs",      mcs_lock,    plain_increment,   mcs_unlock,    plain_read,
+                NULL,        NULL,              NULL, NULL, mcs_loop,
+                mcs_stripe_loop },
+  { "clh",      clh_lock,    plain_increment,   clh_unlock,    plain_read,
+                NULL,        NULL,              NULL, NULL, clh_loop,
+                clh_stripe_loop },
+  { "cohort",   cohort_lock, plain_increment,   cohort_unlock, plain_read,
+                NULL,        NULL,              cohort_setup, cohort_cleanup, cohort_loop,
+                cohort_stripe_loop },
+  { "elided",   elided_lock, plain_increment,   elided_unlock, plain_read,
+                NULL,        NULL,              elided_setup, NULL, elided_loop,
+                elided_stripe_loop },
+  { "combining", no_lock,    fc_increment,      no_lock,       plain_read,
+                NULL,        NULL,              NULL, NULL, combining_loop, NULL },
+  { "striped",  stripe_lock, stripe_increment,  stripe_unlock, stripe_read,
+                no_lock,     no_lock,           NULL, NULL, striped_loop, NULL },
+  { "sharded",  no_lock,     sharded_increment, no_lock,       sharded_read,
+                NULL,        NULL,              NULL, NULL, sharded_loop, NULL },
+  { "adder",    no_lock,     adder_increment,   no_lock,       adder_read,
+                NULL,        NULL,              adder_setup, adder_cleanup, adder_loop, NULL },
+  { "none",     no_lock,     plain_increment,   no_lock,       plain_read,
+                NULL,        NULL,              NULL, NULL, none_loop,
+                none_stripe_loop },   //unprotected, races
+};
+#define NUM_MODES	(sizeof (modes) / sizeof (modes [0]))
+
+/* return the mode with the given name, or NULL if there is none */
+static const struct sync_ops * find_mode (const char * name)
+{
+  for (size_t i = 0; i < NUM_MODES; i++)
+    if (strcmp (modes [i].name, name) == 0)
+      return &(modes [i]);
+  return NULL;
+}
+
+/* the queue kernel: instead of incrementing the counter, half the
+ * threads (rounded down) push num_loops values each into a bounded
+ * queue, and the others pop all of them.  Like sync_ops, but setup
+ * creates the queue and cleanup removes it. */
+struct queue_ops {
+  const char * name;
+  int (* setup) (struct state_struct * state);
+  void (* push) (struct state_struct * state, long value);
+  long (* pop) (struct state_struct * state);
+  void (* cleanup) (struct state_struct * state);
+};
+
+/* condvar queue: a ring buffer protected by a mutex, where producers
+ * wait for ring_not_full and consumers for ring_not_empty */
+static int condvar_setup (struct state_struct * state)
+{
+  state->ring = malloc (state->queue_size * sizeof (long));
+  if (state->ring == NULL) {
+    printf( "unable to allocate %ld queue slots\n", state->queue_size );
+    return -1;
+  }
+  state->ring_head = 0;
+  state->ring_count = 0;
+  if ((pthread_mutex_init(&state->ring_lock, NULL) != 0) ||
+      (pthread_cond_init(&state->ring_not_empty, NULL) != 0) ||
+      (pthread_cond_init(&state->ring_not_full, NULL) != 0)) {
+    printf( "queue initialization failed\n" );
+    free (state->ring);
+    return -1;
+  }
+  return 0;
+}
+
+static void condvar_push (struct state_struct * state, long value)
+{
+  pthread_mutex_lock(&state->ring_lock);
+  while (state->ring_count == state->queue_size)
+    pthread_cond_wait(&state->ring_not_full, &state->ring_lock);
+  state->ring [(state->ring_head + state->ring_count) & (state->queue_size - 1)] = value;
+  state->ring_count++;
+  pthread_cond_signal(&state->ring_not_empty);
+  pthread_mutex_unlock(&state->ring_lock);
+}
+
+static long condvar_pop (struct state_struct * state)
+{
+  pthread_mutex_lock(&state->ring_lock);
+  while (state->ring_count == 0)
+    pthread_cond_wait(&state->ring_not_empty, &state->ring_lock);
+  long value = state->ring [state->ring_head];
+  state->ring_head = (state->ring_head + 1) & (state->queue_size - 1);
+  state->ring_count--;
+  pthread_cond_signal(&state->ring_not_full);
+  pthread_mutex_unlock(&state->ring_lock);
+  return value;
+}
+
+static void condvar_cleanup (struct state_struct * state)
+{
+  pthread_cond_destroy(&state->ring_not_full);
+  pthread_cond_destroy(&state->ring_not_empty);
+  pthread_mutex_destroy(&state->ring_lock);
+  free (state->ring);
+}
+
+/* mpmc queue: Dmitry Vyukov's bounded lock-free queue.  A cell is
+ * free for the producer at position pos when its seq is pos, and
+ * holds a value for the consumer at pos when its seq is pos + 1; each
+ * side claims a position by advancing its counter with a CAS.  A full
+ * or empty queue is waited out with sched_yield, since the thread
+ * that can change that may need this CPU. */
+static int mpmc_setup (struct state_struct * state)
+{
+  state->cells = malloc (state->queue_size * sizeof (struct mpmc_cell));
+  if (state->cells == NULL) {
+    printf( "unable to allocate %ld queue slots\n", state->queue_size );
+    return -1;
+  }
+  for (long i = 0; i < state->queue_size; i++)
+    atomic_init(&state->cells [i].seq, i);
+  atomic_init(&state->enqueue_pos, 0);
+  atomic_init(&state->dequeue_pos, 0);
+  return 0;
+}
+
+static void mpmc_push (struct state_struct * state, long value)
+{
+  unsigned long pos = atomic_load_explicit(&state->enqueue_pos, memory_order_relaxed);
+  struct mpmc_cell * cell;
+  for (;;) {
+    cell = &(state->cells [pos & (state->queue_size - 1)]);
+    long diff = (long) (atomic_load_explicit(&cell->seq, memory_order_acquire) - pos);
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&state->enqueue_pos, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+        break;                                                  //pos is ours
+    } else {
+      if (diff < 0)                                             //full
+        sched_yield();
+      pos = atomic_load_explicit(&state->enqueue_pos, memory_order_relaxed);
+    }
+  }
+  cell->value = value;
+  atomic_store_explicit(&cell->seq, pos + 1, memory_order_release);
+}
+
+static long mpmc_pop (struct state_struct * state)
+{
+  unsigned long pos = atomic_load_explicit(&state->dequeue_pos, memory_order_relaxed);
+  struct mpmc_cell * cell;
+  for (;;) {
+    cell = &(state->cells [pos & (state->queue_size - 1)]);
+    long diff = (long) (atomic_load_explicit(&cell->seq, memory_order_acquire) - (pos + 1));
+    if (diff == 0) {
+      if (atomic_compare_exchange_weak_explicit(&state->dequeue_pos, &pos, pos + 1,
+                                                memory_order_relaxed, memory_order_relaxed))
+        break;
+    } else {
+      if (diff < 0)                                             //empty
+        sched_yield();
+      pos = atomic_load_explicit(&state->dequeue_pos, memory_order_relaxed);
+    }
+  }
+  long value = cell->value;
+  atomic_store_explicit(&cell->seq, pos + state->queue_size, memory_order_release);
+  return value;
+}
+
+static void mpmc_cleanup (struct state_struct * state)
+{
+  free (state->cells);
+}
+
+static const struct queue_ops queues [] = {
+  { "condvar",  condvar_setup, condvar_push, condvar_pop, condvar_cleanup },
+  { "mpmc",     mpmc_setup,    mpmc_push,    mpmc_pop,    mpmc_cleanup },
+};
+#define NUM_QUEUES	(sizeof (queues) / sizeof (queues [0]))
+
+/* return the queue with the given name, or NULL if there is none */
+static const struct queue_ops * find_queue (const char * name)
+{
+  for (size_t i = 0; i < NUM_QUEUES; i++)
+    if (strcmp (queues [i].name, name) == 0)
+      return &(queues [i]);
+  return NULL;
+}
+
+/* the number of operations thread id does in the queue kernel:
+ * num_loops pushes for a producer, or its share of all of them for a
+ * consumer */
+static long queue_ops_of (const struct state_struct * state, long id)
+{
+  if (id < state->producers)
+    return state->num_loops;
+  long consumers = state->num_workers - state->producers;
+  long total = state->producers * state->num_loops;
+  long consumer = id - state->producers;
+  return total / consumers + ((consumer < total % consumers) ? 1 : 0);
+}
+
+/* a producer pushes 1 .. num_loops, a consumer pops its share and adds
+ * up the values in read_sum, so that no value can be lost unnoticed.
+ * One in state->sample_every operations is timed. */
+static void queue_loop (struct state_struct * state, struct worker * self)
+{
+  const struct queue_ops * queue = state->queue;
+  long ops = queue_ops_of (state, self->id);
+  int producer = (self->id < state->producers);
+  for (long i = 0; i < ops; i++) {
+    long started = (i % state->sample_every == 0) ? clock_ns (WALL_CLOCK) : 0;
+    if (producer)
+      queue->push(state, i + 1);
+    else
+      self->read_sum += queue->pop(state);
+    if (i % state->sample_every == 0)
+      histogram_add (&self->latency, clock_ns (WALL_CLOCK) - started);
+  }
+  self->increments = ops;
+}
+
+static void usage (const char * program)
+{
+  printf ("usage: %s [options] [threads [loops]]\n", program);
+  printf ("  --mode=NAME[,NAME...]  synchronization mode(s), default mutex:\n   ");
+  for (size_t i = 0; i < NUM_MODES; i++)
+    printf (" %s", modes [i].name);
+  printf ("\n");
+  printf ("  --sweep                run 1, 2, 4, ... threads (up to twice the number\n"
+          "                         of CPUs, or to threads if given) and 1000, 10000,\n"
+          "                         ... loops (up to loops)\n");
+  printf ("  --duration=SECONDS     run each thread for this long instead of for loops\n");
+  printf ("  --read-ratio=PERCENT   read the counter in this many of the rounds\n");
+  printf ("  --batch=N[,N...]       increments per lock acquisition, default 1\n");
+  printf ("  --repeat=K             run each sweep configuration K times, default %d\n",
+          REPEAT);
+  printf ("  --counters=M[,M...]    spread the increments over M counters, default 1\n");
+  printf ("  --pick=HOW             how each increment picks its counter: roundrobin\n"
+          "                         (the default), random, or thread (hashed by thread)\n");
+  printf ("  --hold=NS              busy work while holding the lock, default 0\n");
+  printf ("  --hold-lines=K         write K shared cache lines while holding the lock\n");
+  printf ("  --think=NS             busy work between acquisitions, default 0\n");
+  printf ("  --oversubscribe=F      run F threads per CPU instead of threads\n");
+  printf ("  --queue=NAME[,NAME...] instead of the counter, half the threads push\n"
+          "                         loops values each through a queue and the others\n"
+          "                         pop them: condvar (mutex and condition variables)\n"
+          "                         or mpmc (lock-free)\n");
+  printf ("  --queue-size=N         slots in the queue, a power of 2, default %d\n", QUEUE_SIZE);
+  printf ("  --trace=FILE           write when each thread started and finished and which\n"
+          "                         lock acquisitions waited to FILE, in Chrome trace\n"
+          "                         format for Perfetto or chrome://tracing (not in sweeps)\n");
+  printf ("  --latency[=N]          time the lock and increment of one in N rounds\n"
+          "                         (default %d) and print percentiles (not in sweeps)\n",
+          SAMPLE_EVERY);
+  printf ("  --indirect             call the mode's functions through pointers instead\n"
+          "                         of running its inlined loop\n");
+  printf ("  --no-calibrate         skip the single-thread baselines before each run\n");
+  printf ("  --json                 print the results as JSON, one run per line, with\n"
+          "                         the configuration and the system (sweeps: instead\n"
+          "                         of CSV)\n");
+  printf ("  --csv                  print the results of single runs as CSV\n");
+  printf ("  --compare=FILE         compare the throughput with the runs of the same\n"
+          "                         configuration in FILE, from an earlier --json run\n");
+  printf ("  --threshold=PERCENT    slowdown that --compare reports as a regression,\n"
+          "                         default %d\n", THRESHOLD);
+  printf ("  --affinity=PLACEMENT   pin the threads: compact (fill each core and socket\n"
+          "                         before the next), scatter (alternate sockets), or a\n"
+          "                         CPU list such as 0-3,8\n");
+  printf ("  --numa=NODE            bind the shared state to the NUMA node\n");
+  printf ("  --spins=N              spinpark mode: tries before sleeping, default %d\n",
+          SPINS);
+  printf ("  --cohort-passes=N      cohort mode: most handoffs within a socket before\n"
+          "                         the lock goes to the next socket, default %d\n",
+          COHORT_PASSES);
+  printf ("  --lockstats            report how long the threads waited for and held\n"
+          "                         each mutex (not in sweeps)\n");
+  printf ("  --perf                 count cycles, instructions and cache misses in the\n"
+          "                         loops with perf_event_open (not in sweeps)\n");
+  printf ("  --perf-raw=EVENT       also count this raw event, e.g. HITM loads\n");
+}
+
+/* after waiting at the start barrier for all the threads to be
+ * created, run the loop of the kernel: increment the state counter
+ * variable with counter_loop (with --read-ratio, some of the rounds
+ * read it instead), or push or pop with queue_loop.  Once that is
+ * finished, print that we are finished. */
+static void * thread(void * arg)
+{
+  struct worker * self = (struct worker *) arg;
+  struct state_struct * state = self->state;
+  struct sync_ops ops_copy = * state->ops;                      //on this thread's stack
+  const struct sync_ops * ops = &ops_copy;
+
+  if (state->perf)
+    perf_open(&self->perf, state->perf_raw);                    //opening takes a while, so do it before the start
+  if (self->trace_waits != NULL)
+    self->trace_ns [TRACE_BARRIER] = clock_ns (WALL_CLOCK);
+  barrier_wait(&state->start_barrier,                           //all the threads begin the loop together
+               self->locks ? &(self->locks [LOCK_BARRIER]) : NULL);
+  if (state->perf)
+    perf_start(&self->perf);
+  struct context_switches switches = context_switches ();
+  struct timestamp start = now (CLOCK_THREAD_CPUTIME_ID);
+  self->start_ns = start.wall_ns;
+  if (self->trace_waits != NULL)
+    self->trace_ns [TRACE_STARTED] = start.wall_ns;
+  if (state->queue != NULL)
+    queue_loop (state, self);
+  else if (ops->loop != NULL)
+    ops->loop(state, self);                                     //the mode's functions inlined
+  else
+    counter_loop (state, self, ops);
+  self->times = all_times (start);
+  if (self->trace_waits != NULL)
+    self->trace_ns [TRACE_FINISHED] = start.wall_ns + self->times.elapsed_ns;
+  self->switches = context_switches ();
+  if (switches.voluntary >= 0) {
+    self->switches.voluntary -= switches.voluntary;
+    self->switches.involuntary -= switches.involuntary;
+  }
+  atomic_store(&self->rcu_seen, ULONG_MAX);                     //rcu mode: never reading again
+  if (state->perf)
+    perf_stop(&self->perf);
+
+  //the count of finished threads is atomic, decreLock keeps the message and the decrement together
+  struct lock_stats * decre_stats = self->locks ? &(self->locks [LOCK_DECRE]) : NULL;
+  stats_lock(&decreLock, decre_stats); 
+  if (! state->quiet)
+    printf ("thread %ld finishing\n", self->id);
+  atomic_fetch_sub_explicit(&state->threads, 1, memory_order_release);
+  stats_unlock(&decreLock, decre_stats);
+  return NULL;
+}
+
+/* print the seconds in ns to a string
+ *
+ * The string returned is in one of a few static arrays, so it can be
+ * used a few times in one printf, but if multiple threads call this
+ * function at the same, the results may be inaccurate.
+ */
+static char * seconds (long ns)
+{
+  static char results [4] [100];
+  static int next = 0;
+  char * result = results [next];
+  next = (next + 1) % 4;
+  snprintf (result, sizeof (results [0]), "%ld.%09ld", ns / NS_PER_S, ns % NS_PER_S);
+  return result;
+}
+
+/* the --affinity choices */
+enum { AFFINITY_NONE, AFFINITY_COMPACT, AFFINITY_SCATTER, AFFINITY_LIST };
+static const char * affinity_names [] = { "none", "compact", "scatter", "list" };
+
+/* where the threads and the shared state go: thread i is pinned to
+ * cpus [i % num_cpus], unless affinity is AFFINITY_NONE */
+struct placement {
+  int affinity;
+  int * cpus;
+  int * packages;                   // the socket of each of the cpus, for reporting
+  int num_cpus;
+  int numa_node;                    // the shared state is bound to this node, or -1
+};
+
+#ifdef HAVE_AFFINITY
+/* a CPU and where it is, from /sys/devices/system/cpu */
+struct cpu_info {
+  int cpu;
+  int package;                      // the socket
+  int core;                         // unique within a package
+  int sibling;                      // 0 for the first hyperthread of a core, 1 for the next, ...
+  int rank;                         // index among the package's CPUs with the same sibling
+};
+
+static int read_topology_value (int cpu, const char * name, int otherwise)
+{
+  char path [100];
+  snprintf (path, sizeof (path), "/sys/devices/system/cpu/cpu%d/topology/%s", cpu, name);
+  FILE * f = fopen (path, "r");
+  if (f == NULL)
+    return otherwise;
+  int value;
+  if (fscanf (f, "%d", &value) != 1)
+    value = otherwise;
+  fclose (f);
+  return value;
+}
+
+static int compare_compact (const void * a, const void * b)
+{
+  const struct cpu_info * x = a;
+  const struct cpu_info * y = b;
+  if (x->package != y->package)
+    return x->package - y->package;
+  if (x->core != y->core)
+    return x->core - y->core;
+  return x->sibling - y->sibling;
+}
+
+static int compare_scatter (const void * a, const void * b)
+{
+  const struct cpu_info * x = a;
+  const struct cpu_info * y = b;
+  if (x->sibling != y->sibling)
+    return x->sibling - y->sibling;
+  if (x->rank != y->rank)
+    return x->rank - y->rank;
+  return x->package - y->package;
+}
+
+/* the CPUs this process may run on, in compact order: SMT siblings
+ * next to each other, then the cores of a socket, then the next
+ * socket.  Returns the number of CPUs, or -1 after printing why. */
+static int read_topology (struct cpu_info ** result)
+{
+  cpu_set_t allowed;
+  if (sched_getaffinity (0, sizeof (allowed), &allowed) != 0) {
+    printf ("unable to get the CPUs this process may use\n");
+    return -1;
+  }
+  int n = 0;
+  struct cpu_info * cpus = malloc (CPU_COUNT (&allowed) * sizeof (struct cpu_info));
+  if (cpus == NULL) {
+    printf ("unable to allocate the CPU topology\n");
+    return -1;
+  }
+  for (int cpu = 0; cpu < CPU_SETSIZE; cpu++) {
+    if (! CPU_ISSET (cpu, &allowed))
+      continue;
+    struct cpu_info * c = &(cpus [n++]);
+    c->cpu = cpu;
+    c->package = read_topology_value (cpu, "physical_package_id", 0);
+    c->core = read_topology_value (cpu, "core_id", cpu);
+    c->sibling = 0;
+    for (int i = 0; i < n - 1; i++)
+      if ((cpus [i].package == c->package) && (cpus [i].core == c->core))
+        c->sibling++;
+  }
+  qsort (cpus, n, sizeof (struct cpu_info), compare_compact);
+  for (int i = 0; i < n; i++) {
+    cpus [i].rank = 0;
+    for (int j = 0; j < i; j++)
+      if ((cpus [j].package == cpus [i].package) && (cpus [j].sibling == cpus [i].sibling))
+        cpus [i].rank++;
+  }
+  *result = cpus;
+  return n;
+}
+
+/* parse a CPU list such as 0-3,8,10 into cpus, which has room for
+ * CPU_SETSIZE entries.  Returns the count, or -1 after printing why. */
+static int parse_cpu_list (char * list, int * cpus)
+{
+  int count = 0;
+  char * item;
+  while ((item = strsep (&list, ",")) != NULL) {
+    char * end;
+    long first = strtol (item, &end, 10);
+    long last = first;
+    if (*end == '-')
+      last = strtol (end + 1, &end, 10);
+    if ((*item == '\0') || (*end != '\0') || (first < 0) || (last < first) ||
+        (last >= CPU_SETSIZE)) {
+      printf ("--affinity: %s is not a CPU or range of CPUs\n", item);
+      return -1;
+    }
+    for (long cpu = first; cpu <= last; cpu++) {
+      if (count >= CPU_SETSIZE) {
+        printf ("--affinity: too many CPUs\n");
+        return -1;
+      }
+      cpus [count++] = cpu;
+    }
+  }
+  return count;
+}
+#endif /* HAVE_AFFINITY */
+
+/* fill in placement->cpus and packages for the given --affinity
+ * argument: compact, scatter, or a list of CPUs.  Returns 0 for
+ * success, or -1 after printing why. */
+static int set_placement (struct placement * placement, char * affinity)
+{
+#ifdef HAVE_AFFINITY
+  struct cpu_info * topology;
+  int num_topology = read_topology (&topology);
+  if (num_topology < 0)
+    return -1;
+  placement->cpus = malloc (CPU_SETSIZE * sizeof (int));
+  placement->packages = malloc (CPU_SETSIZE * sizeof (int));
+  if ((placement->cpus == NULL) || (placement->packages == NULL)) {
+    printf ("unable to allocate the CPU placement\n");
+    return -1;
+  }
+  if (strcmp (affinity, "compact") == 0) {
+    placement->affinity = AFFINITY_COMPACT;
+  } else if (strcmp (affinity, "scatter") == 0) {
+    placement->affinity = AFFINITY_SCATTER;
+    qsort (topology, num_topology, sizeof (struct cpu_info), compare_scatter);
+  } else {
+    placement->affinity = AFFINITY_LIST;
+    placement->num_cpus = parse_cpu_list (affinity, placement->cpus);
+    if (placement->num_cpus < 0)
+      return -1;
+  }
+  if (placement->affinity != AFFINITY_LIST) {
+    placement->num_cpus = num_topology;
+    for (int i = 0; i < num_topology; i++)
+      placement->cpus [i] = topology [i].cpu;
+  }
+  for (int i = 0; i < placement->num_cpus; i++) {
+    placement->packages [i] = -1;                               //unknown, unless the process may use it
+    for (int j = 0; j < num_topology; j++)
+      if (topology [j].cpu == placement->cpus [i])
+        placement->packages [i] = topology [j].package;
+  }
+  free (topology);
+  return 0;
+#else
+  (void) placement;
+  printf ("--affinity=%s: CPU affinity is not supported on this system\n", affinity);
+  return -1;
+#endif /* HAVE_AFFINITY */
+}
+
+/* the socket thread i is pinned to, or -1 if unknown or not pinned */
+static int package_of (const struct placement * placement, long i)
+{
+  if (placement->affinity == AFFINITY_NONE)
+    return -1;
+  return placement->packages [i % placement->num_cpus];
+}
+
+/* the number of different sockets used by the first num_threads threads */
+static int sockets_used (const struct placement * placement, long num_threads)
+{
+  int count = 0;
+  if (placement->affinity == AFFINITY_NONE)
+    return 0;
+  for (long i = 0; (i < num_threads) && (i < placement->num_cpus); i++) {
+    int seen = 0;
+    for (long j = 0; j < i; j++)
+      if (placement->packages [j] == placement->packages [i])
+        seen = 1;
+    count += ! seen;
+  }
+  return count;
+}
+
+/* print where the first num_threads threads will run */
+static void print_placement (const struct placement * placement, long num_threads)
+{
+  printf ("placement: %s", affinity_names [placement->affinity]);
+  if (placement->affinity != AFFINITY_NONE) {
+    printf (", threads on cpus");
+    for (long i = 0; i < num_threads; i++)
+      printf ("%s%d", (i == 0) ? " " : ",", placement->cpus [i % placement->num_cpus]);
+    printf (" (sockets");
+    for (long i = 0; i < num_threads; i++)
+      printf ("%s%d", (i == 0) ? " " : ",", placement->packages [i % placement->num_cpus]);
+    printf ("; %d different)", sockets_used (placement, num_threads));
+  }
+  if (placement->numa_node >= 0)
+    printf (", memory on node %d", placement->numa_node);
+  printf ("\n");
+}
+
+/* allocate size bytes of page-aligned memory, bound to the given NUMA
+ * node unless node is -1.  Returns NULL after printing why on failure. */
+static void * alloc_shared (size_t size, int node)
+{
+  size_t page = sysconf (_SC_PAGESIZE);
+  size = (size + page - 1) / page * page;
+  void * result = aligned_alloc (page, size);
+  if (result == NULL) {
+    printf ("unable to allocate %zu bytes\n", size);
+    return NULL;
+  }
+#ifdef HAVE_AFFINITY
+  if (node >= 0) {
+    unsigned long mask = 1UL << node;
+    if (syscall (SYS_mbind, result, size, MPOL_BIND, &mask, 8 * sizeof (mask) + 1,
+                 MPOL_MF_MOVE) != 0) {
+      printf ("unable to bind memory to NUMA node %d\n", node);
+      free (result);
+      return NULL;
+    }
+  }
+#endif /* HAVE_AFFINITY */
+  return result;
+}
+
+/* threads created once and reused by every trial, so that repeated
+ * runs don't pay for creating and joining threads, and each thread
+ * keeps its CPU, stack and caches from one trial to the next.
+ * Between trials the threads wait on dispatched; pool_dispatch hands
+ * the first wanted of them a worker each, and once they have all
+ * returned from thread() pool_wait returns in main. */
+struct pool_thread {
+  pthread_t handle;
+  long index;                       // runs workers [index] of each trial
+  struct pool * pool;
+  long created_ns;                  // wall clock time when the thread began, for --trace
+};
+
+struct pool {
+  pthread_mutex_t lock;
+  pthread_cond_t dispatched;        //broadcast when a trial starts, or to exit
+  pthread_cond_t finished;          //signalled when the last thread of a trial is done
+  unsigned long generation;         // incremented for every trial
+  long size;                        // number of threads
+  long wanted;                      // the threads used by the current trial
+  long running;                     // of those, the ones not yet done
+  struct worker * workers;          // wanted of them, for the current trial
+  int exit;                         // set when the threads should return
+  struct pool_thread * threads;
+};
+
+static void * pool_thread (void * arg)
+{
+  struct pool_thread * self = (struct pool_thread *) arg;
+  struct pool * pool = self->pool;
+  unsigned long generation = 0;
+  self->created_ns = clock_ns (WALL_CLOCK);
+  pthread_mutex_lock(&pool->lock);
+  for (;;) {
+    while (pool->generation == generation)
+      pthread_cond_wait(&pool->dispatched, &pool->lock);
+    generation = pool->generation;
+    if (pool->exit)
+      break;
+    if (self->index >= pool->wanted)                            //not needed for this trial
+      continue;
+    struct worker * w = &(pool->workers [self->index]);
+    pthread_mutex_unlock(&pool->lock);
+    if (w->trace_waits != NULL) {
+      w->trace_ns [TRACE_CREATED] = self->created_ns;
+      w->trace_ns [TRACE_WOKEN] = clock_ns (WALL_CLOCK);
+    }
+    thread(w);
+    pthread_mutex_lock(&pool->lock);
+    if (--(pool->running) == 0)
+      pthread_cond_signal(&pool->finished);
+  }
+  pthread_mutex_unlock(&pool->lock);
+  return NULL;
+}
+
+static void pool_destroy (struct pool * pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->exit = 1;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->dispatched);
+  pthread_mutex_unlock(&pool->lock);
+  for (long i = 0; i < pool->size; i++)
+    pthread_join(pool->threads [i].handle, NULL);
+  pthread_cond_destroy(&pool->finished);
+  pthread_cond_destroy(&pool->dispatched);
+  pthread_mutex_destroy(&pool->lock);
+  free (pool->threads);
+}
+
+/* create size threads, thread i pinned as the placement says for
+ * workers [i].  Returns 0 for success, or -1 after printing why. */
+static int pool_create (struct pool * pool, long size, const struct placement * placement)
+{
+  pool->threads = malloc (size * sizeof (struct pool_thread));
+  if (pool->threads == NULL) {
+    printf( "unable to allocate %ld threads\n", size );
+    return -1;
+  }
+  if ((pthread_mutex_init(&pool->lock, NULL) != 0) ||
+      (pthread_cond_init(&pool->dispatched, NULL) != 0) ||
+      (pthread_cond_init(&pool->finished, NULL) != 0)) {
+    printf( "thread pool initialization failed\n" );
+    free (pool->threads);
+    return -1;
+  }
+  pool->generation = 0;
+  pool->size = 0;
+  pool->wanted = 0;
+  pool->running = 0;
+  pool->workers = NULL;
+  pool->exit = 0;
+  while (pool->size < size) {
+    struct pool_thread * t = &(pool->threads [pool->size]);
+    t->index = pool->size;
+    t->pool = pool;
+    pthread_attr_t attr;
+    pthread_attr_init(&attr);
+#ifdef HAVE_AFFINITY
+    if (placement->affinity != AFFINITY_NONE) {
+      cpu_set_t cpus;
+      CPU_ZERO (&cpus);
+      CPU_SET (placement->cpus [t->index % placement->num_cpus], &cpus);
+      pthread_attr_setaffinity_np(&attr, sizeof (cpus), &cpus);
+    }
+#else
+    (void) placement;
+#endif /* HAVE_AFFINITY */
+    int error = pthread_create (&(t->handle), &attr, pool_thread, (void *)t); //start routine = pool_thread() <above>
+    pthread_attr_destroy(&attr);
+    if (error != 0) {
+      printf( "unable to create thread %ld\n", t->index );
+      pool_destroy (pool);                                              //stops the ones already created
+      return -1;
+    }
+    pool->size++;                                                       //incease the number of threads in the pool
+    #ifdef DEBUG
+        printf("{thread creator}: there are %ld threads\n", pool->size);
+    #endif
+  }
+  return 0;
+}
+
+/* start thread() for each of the num workers in the first num threads */
+static void pool_dispatch (struct pool * pool, struct worker * workers, long num)
+{
+  pthread_mutex_lock(&pool->lock);
+  pool->workers = workers;
+  pool->wanted = num;
+  pool->running = num;
+  pool->generation++;
+  pthread_cond_broadcast(&pool->dispatched);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* wait until every thread dispatched to has returned from thread() */
+static void pool_wait (struct pool * pool)
+{
+  pthread_mutex_lock(&pool->lock);
+  while (pool->running > 0)
+    pthread_cond_wait(&pool->finished, &pool->lock);
+  pthread_mutex_unlock(&pool->lock);
+}
+
+/* the settings from the command line */
+struct options {
+  const struct sync_ops * modes [NUM_MODES];   // from --mode, run in this order
+  int num_modes;
+  long batches [MAX_LIST];          // from --batch, run in this order
+  int num_batches;
+  long num_threads;                 // for a sweep, the largest number of threads
+  int threads_given;                // 1 if num_threads came from the command line
+  long num_loops;                   // for a sweep, the largest number of loops
+  int sweep;                        // --sweep
+  int repeat;                       // --repeat, runs per sweep configuration
+  int json;                         // --json, otherwise sweeps print CSV
+  int csv;                          // --csv, for single runs
+  const char * compare;             // --compare, the baseline file, or NULL
+  long threshold;                   // --threshold, in percent
+  struct placement placement;       // from --affinity and --numa
+  int lock_stats;                   // --lockstats
+  int perf;                         // --perf or --perf-raw
+  long perf_raw;                    // --perf-raw, or -1
+  long spins;                       // --spins
+  long cohort_passes;               // --cohort-passes
+  long duration_ns;                 // --duration, or 0 to run num_loops
+  long read_percent;                // --read-ratio
+  int calibrate;                    // unless --no-calibrate, run the baselines first
+  long counters [MAX_LIST];         // from --counters, run in this order
+  int num_counters;
+  int pick;                         // --pick
+  long hold_ns;                     // --hold
+  long hold_lines;                  // --hold-lines
+  long think_ns;                    // --think
+  long oversubscribe;               // --oversubscribe, threads per CPU, or 0
+  const struct queue_ops * queues [NUM_QUEUES];  // from --queue, run instead of the modes
+  int num_queues;
+  long queue_size;                  // --queue-size
+  long sample_every;                // --latency, or 0
+  int indirect;                     // --indirect
+  struct trace trace;               // --trace, file NULL if not given
+};
+
+/* the settings for one run of the threads */
+struct trial_config {
+  const struct sync_ops * ops;
+  long num_threads;
+  long num_loops;
+  long duration_ns;                 // if not 0, run for this long instead of num_loops
+  long batch;
+  int read_percent;                 // percentage of rounds that read instead of increment
+  long counters;                    // number of counters, see --counters
+  int pick;                         // how the threads pick one, a PICK_ value
+  long hold_ns;                     // busy work while holding the lock, see --hold
+  long hold_lines;                  // cache lines written while holding the lock
+  long think_ns;                    // busy work between acquisitions, see --think
+  const struct queue_ops * queue;   // if not NULL, run the queue kernel with this queue
+  long queue_size;                  // slots in the queue, a power of 2
+  long sample_every;                // time one in this many operations, or 0
+  int indirect;                     // if set, call the mode's functions through pointers
+  struct trace * trace;             // if not NULL, trace the threads into this
+  const struct placement * placement;
+  int spins;                        // spinpark mode: tries before parking
+  long cohort_passes;               // cohort mode: most handoffs within a socket in a row
+  int lock_stats;                   // if set, record the use of the mutexes
+  int perf;                         // if set, collect hardware counters
+  long perf_raw;                    // config of the raw hardware counter, or -1
+  int quiet;                        // if set, the threads don't print when finishing
+  struct pool * pool;               // the threads to run it on, at least num_threads
+};
+
+/* what one thread did, for the per-thread report */
+struct thread_stats {
+  long id;
+  int cpu;                          // the CPU the thread was pinned to, or -1
+  long start_ns;                    // when its loop started, after the start barrier opened
+  long finish_ns;                   // when its loop finished, after the start barrier opened
+  long increments;
+  long reads;
+  long cpu_ns;                      // CPU time of its loop
+  struct context_switches switches; // during its loop, -1 if not counted
+  long lock_waits;                  // contended acquisitions of countLock, or -1 if not recorded
+                                    // (without --lockstats, or if the mode doesn't use countLock)
+};
+
+/* the outcome of one run of the threads */
+struct trial_result {
+  long count;                       // final value of the counter
+  long expected;                    // increments done by all the threads
+  long reads;                       // reads done by all the threads
+  struct times times;               // of the process, from the start barrier until all the threads are done
+  long thread_cpu_ns;               // total over the threads, of their loops only
+  long thread_loop_ns;              // total over the threads of their loops' elapsed times
+  struct context_switches switches; // total over the threads' loops, -1 if not counted
+  long fastest_ns;                  // shortest and longest loop time of any thread
+  long slowest_ns;
+  double jain;                      // Jain's fairness index of the increments per second of each thread
+  struct thread_stats * threads;    // one per thread, to be freed by the caller
+  struct lock_stats locks [NUM_LOCKS];  // total over the threads, if config->lock_stats
+  long perf [NUM_PERF];             // total over the threads, -1 if any thread could not count
+  int perf_error;                   // errno from perf_event_open, or 0
+  long pushed_sum;                  // queue kernel: the values pushed and popped, added up
+  long popped_sum;
+  struct histogram latency;         // of the timed operations of all the threads
+  long cohorts;                     // cohort mode: sockets with threads
+  long cohort_acquires;             // cohort mode: total over the threads
+  long cohort_handoffs;
+  long adder_cells;                 // adder mode: cells at the end, -1 in the other modes
+  long adder_max;                   // adder mode: the most cells it could have grown to
+  long adder_collisions;            // adder mode: failed compare and swaps, total over the threads
+  int elide_rtm;                    // elided mode: 1 if it used transactions, 0 if not, -1 in the other modes
+  long elide_commits;               // elided mode: totals over the threads
+  long elide_fallbacks;
+  long elide_aborts [NUM_ABORTS];
+};
+
+/* begin the trace file.  Returns 0 for success, or -1 after printing why. */
+static int open_trace (struct trace * trace)
+{
+  trace->file = fopen (trace->path, "w");
+  if (trace->file == NULL) {
+    printf ("--trace: unable to create %s: %s\n", trace->path, strerror (errno));
+    return -1;
+  }
+  trace->epoch_ns = clock_ns (WALL_CLOCK);
+  trace->runs = 0;
+  trace->events = 0;
+  trace->dropped = 0;
+  fprintf (trace->file, "{\"displayTimeUnit\": \"ns\", \"traceEvents\": [");
+  return 0;
+}
+
+/* write one event.  ts and dur are in microseconds in this format;
+ * dur < 0 for an instant event, and name is a JSON string. */
+static void trace_event (struct trace * trace, const char * name, long tid,
+                         long ns, long dur_ns)
+{
+  fprintf (trace->file, "%s\n{\"name\": \"%s\", \"pid\": %d, \"tid\": %ld, \"ts\": %.3f, ",
+           (trace->events == 0) ? "" : ",", name, trace->runs, tid,
+           (ns - trace->epoch_ns) / 1000.0);
+  if (dur_ns < 0)
+    fprintf (trace->file, "\"ph\": \"i\", \"s\": \"t\"}");
+  else
+    fprintf (trace->file, "\"ph\": \"X\", \"dur\": %.3f}", dur_ns / 1000.0);
+  trace->events++;
+}
+
+/* write the events of every thread of the trial that just finished,
+ * as a new process of the trace with one track per thread */
+static void write_trace (const struct trial_config * config, const struct state_struct * state)
+{
+  struct trace * trace = config->trace;
+  trace->runs++;
+  fprintf (trace->file, "%s\n{\"name\": \"process_name\", \"ph\": \"M\", \"pid\": %d, "
+           "\"args\": {\"name\": \"%s %s, %ld threads\"}}",
+           (trace->events == 0) ? "" : ",", trace->runs,
+           (config->queue != NULL) ? "queue" : "mode",
+           (config->queue != NULL) ? config->queue->name : config->ops->name,
+           state->num_workers);
+  trace->events++;
+  for (long i = 0; i < state->num_workers; i++) {
+    const struct worker * w = &(state->workers [i]);
+    fprintf (trace->file, ",\n{\"name\": \"thread_name\", \"ph\": \"M\", \"pid\": %d, "
+             "\"tid\": %ld, \"args\": {\"name\": \"thread %ld", trace->runs, w->id, w->id);
+    if (w->cpu >= 0)
+      fprintf (trace->file, " on cpu %d", w->cpu);
+    fprintf (trace->file, "\"}}");
+    trace->events++;
+    for (int t = 0; t < NUM_TRACE; t++)
+      if (w->trace_ns [t] != 0)
+        trace_event (trace, trace_names [t], w->id, w->trace_ns [t], -1);
+    if ((w->trace_ns [TRACE_BARRIER] != 0) && (w->trace_ns [TRACE_STARTED] != 0))
+      trace_event (trace, "start barrier", w->id, w->trace_ns [TRACE_BARRIER],
+                   w->trace_ns [TRACE_STARTED] - w->trace_ns [TRACE_BARRIER]);
+    if ((w->trace_ns [TRACE_STARTED] != 0) && (w->trace_ns [TRACE_FINISHED] != 0))
+      trace_event (trace, "loop", w->id, w->trace_ns [TRACE_STARTED],
+                   w->trace_ns [TRACE_FINISHED] - w->trace_ns [TRACE_STARTED]);
+    long first = (w->trace_num_waits > TRACE_EVENTS) ? w->trace_num_waits - TRACE_EVENTS : 0;
+    for (long e = first; e < w->trace_num_waits; e++) {
+      const struct trace_wait * wait = &(w->trace_waits [e % TRACE_EVENTS]);
+      trace_event (trace, "lock contended", w->id, wait->start_ns, wait->wait_ns);
+    }
+    trace->dropped += first;
+  }
+}
+
+/* finish the trace file, and unless quiet say where it is */
+static void close_trace (struct trace * trace, int quiet)
+{
+  fprintf (trace->file, "\n]}\n");
+  fclose (trace->file);
+  if (quiet)
+    return;
+  printf ("trace: %ld events of %d runs written to %s", trace->events, trace->runs, trace->path);
+  if (trace->dropped > 0)
+    printf (" (%ld older lock waits overwritten)", trace->dropped);
+  printf ("\n");
+}
+
+/* dispatch the pool's threads, start them all together, and wait for
+ * them to finish.  Returns 0 for success, or -1 if the threads could not be
+ * set up, in which case the reason has been printed. */
+static int run_trial (const struct trial_config * config, struct trial_result * result)
+{
+  long num_threads = config->num_threads;
+  const struct placement * placement = config->placement;
+  struct state_struct * state = alloc_shared (sizeof (struct state_struct),
+                                              placement->numa_node);
+  if (state == NULL)
+    return -1;
+  *state = (struct state_struct)
+    { .counter = 0, .threads = 0, .num_loops = config->num_loops,
+      .batch = config->batch, .ops = config->ops, .spin = ATOMIC_FLAG_INIT,
+      .quiet = config->quiet, .perf = config->perf, .perf_raw = config->perf_raw,
+      .spins = config->spins, .timed = (config->duration_ns > 0),
+      .cohort_passes = config->cohort_passes,
+      .read_percent = config->read_percent, .pick = config->pick,
+      .hold_work = config->hold_ns * busy_work_per_ns (),
+      .think_work = config->think_ns * busy_work_per_ns (),
+      .hold_lines = config->hold_lines, .queue = config->queue,
+      .queue_size = config->queue_size, .producers = config->num_threads / 2,
+      .sample_every = (config->queue != NULL) ?                         //the queue kernel always samples
+                      ((config->sample_every > 0) ? config->sample_every : SAMPLE_EVERY) :
+                      config->sample_every };
+  state->clh_tail = &(state->clh_dummy);
+  state->mode = *config->ops;                                           //the threads copy this, not the table entry
+  if (state->mode.read_lock == NULL)
+    state->mode.read_lock = state->mode.lock;
+  if (state->mode.read_unlock == NULL)
+    state->mode.read_unlock = state->mode.unlock;
+  state->num_stripes = (config->counters > 1) ? config->counters : 1;
+  if (state->num_stripes > 1) {                                         //the locked modes update a stripe instead
+    if (state->mode.increment == plain_increment) {
+      state->mode.increment = stripe_increment;
+      state->mode.loop = state->mode.stripe_loop;                       //specialized for stripe_increment
+    }
+    if (state->mode.read == plain_read)
+      state->mode.read = stripe_read;
+  }
+  if (config->indirect)
+    state->mode.loop = NULL;
+  state->ops = &(state->mode);
+  if (state->hold_lines > 0) {
+    state->hold_buffer = alloc_shared (state->hold_lines * CACHE_LINE, placement->numa_node);
+    if (state->hold_buffer == NULL) {
+      free (state);
+      return -1;
+    }
+    memset (state->hold_buffer, 0, state->hold_lines * CACHE_LINE);
+  }
+  state->stripes = alloc_shared (state->num_stripes * sizeof (struct stripe),
+                                 placement->numa_node);
+  if (state->stripes == NULL) {
+    free (state->hold_buffer);
+    free (state);
+    return -1;
+  }
+  for (long i = 0; i < state->num_stripes; i++) {
+    state->stripes [i].value = 0;
+    if (pthread_mutex_init(&(state->stripes [i].lock), NULL) != 0) {
+      printf( "stripe mutex initialization failed\n" );
+      exit (-1);
+    }
+  }
+  state->workers = alloc_shared (num_threads * sizeof (struct worker), placement->numa_node);
+  if (state->workers == NULL) {
+    free (state->stripes);
+    free (state->hold_buffer);
+    free (state);
+    return -1;
+  }
+  state->num_workers = num_threads;
+  for (long i = 0; i < num_threads; i++) {
+    struct worker * w = &(state->workers [i]);
+    w->count = 0;
+    w->id = i;
+    w->state = state;
+    w->cpu = (placement->affinity != AFFINITY_NONE) ?                   //where the pool pinned its thread
+             placement->cpus [i % placement->num_cpus] : -1;
+    w->clh_mine = &(w->clh);
+    w->cohort = state->num_cohorts;                                     //a new socket, unless seen before
+    for (long j = 0; j < i; j++)
+      if (package_of (placement, j) == package_of (placement, i))
+        w->cohort = state->workers [j].cohort;
+    if (w->cohort == state->num_cohorts)
+      state->num_cohorts++;
+    w->cohort_acquires = 0;
+    w->cohort_handoffs = 0;
+    w->adder_collisions = 0;
+    w->elide_commits = 0;
+    w->elide_fallbacks = 0;
+    memset (w->elide_aborts, 0, sizeof (w->elide_aborts));
+    memset (w->trace_ns, 0, sizeof (w->trace_ns));
+    w->trace_waits = NULL;
+    w->trace_num_waits = 0;
+    if (config->trace != NULL) {
+      w->trace_waits = malloc (TRACE_EVENTS * sizeof (struct trace_wait));
+      if (w->trace_waits == NULL) {
+        printf( "unable to allocate the trace of thread %ld\n", i );
+        exit (-1);
+      }
+    }
+    w->fc.pending = 0;
+    w->sample_countdown = state->sample_every;
+    memset (&(w->latency), 0, sizeof (w->latency));
+    w->reads = 0;
+    w->read_sum = 0;
+    w->random = 0x9e3779b97f4a7c15UL * (w->id + 1);                     //any nonzero seed, different per thread
+    w->adder_probe = w->random;                                         //nonzero, so rehashing moves the thread
+    w->stripe = (config->pick == PICK_THREAD) ?                         //hashed, so threads may share a counter
+                (long) ((w->random >> 32) % state->num_stripes) : w->id % state->num_stripes;
+    w->rcu_seen = 0;
+    w->rcu_retired = NULL;
+    w->rcu_num_retired = 0;
+    w->rcu_reclaim_at = RCU_RECLAIM;
+    memset (w->lock_stats, 0, sizeof (w->lock_stats));
+    w->locks = config->lock_stats ? w->lock_stats : NULL;
+  }
+  if ((state->queue != NULL) && (state->queue->setup(state) != 0)) {
+    free (state->workers);
+    free (state->stripes);
+    free (state->hold_buffer);
+    free (state);
+    return -1;
+  }
+  if ((state->ops->setup != NULL) && (state->ops->setup(state) != 0)) {
+    free (state->workers);
+    free (state->stripes);
+    free (state->hold_buffer);
+    free (state);
+    return -1;
+  }
+  if (barrier_init(&state->start_barrier, num_threads + 1) != 0){       //+ 1 for main
+    printf( "start barrier initialization failed\n" );
+    if (state->ops->cleanup != NULL)
+      state->ops->cleanup(state);
+    free (state->workers);
+    free (state->stripes);
+    free (state->hold_buffer);
+    free (state);
+    return -1; 
+  }
+  
+  atomic_store_explicit(&state->threads, num_threads, memory_order_relaxed);  //published by pool_dispatch's mutex
+  pool_dispatch (config->pool, state->workers, num_threads);
+  
+  //start all the threads, and get time of loop from when they are released
+  barrier_wait(&state->start_barrier, NULL);
+  if (config->duration_ns > 0) {
+    struct timespec duration =
+      { .tv_sec = config->duration_ns / NS_PER_S, .tv_nsec = config->duration_ns % NS_PER_S };
+    while (nanosleep (&duration, &duration) != 0)                       //interrupted, sleep the rest
+      ;
+    atomic_store_explicit(&state->stop, 1, memory_order_relaxed);
+  }
+
+  result->threads = malloc (num_threads * sizeof (struct thread_stats));
+  if (result->threads == NULL) {
+    printf( "unable to allocate %ld thread results\n", num_threads );
+    exit (-1);                                                          //the threads are already running
+  }
+  double rate_sum = 0.0;
+  double rate_squares = 0.0;
+  result->expected = 0;
+  result->reads = 0;
+  result->thread_cpu_ns = 0;
+  result->thread_loop_ns = 0;
+  result->switches = (struct context_switches) { 0, 0 };
+  result->fastest_ns = -1;
+  result->slowest_ns = 0;
+  memset (result->locks, 0, sizeof (result->locks));
+  memset (result->perf, 0, sizeof (result->perf));
+  result->perf_error = 0;
+  result->cohorts = state->num_cohorts;
+  result->cohort_acquires = 0;
+  result->cohort_handoffs = 0;
+  result->adder_collisions = 0;
+  result->elide_commits = 0;
+  result->elide_fallbacks = 0;
+  memset (result->elide_aborts, 0, sizeof (result->elide_aborts));
+  pool_wait (config->pool);                                             /* wait until all the threads are done */
+  if (atomic_load_explicit(&state->threads, memory_order_acquire) != 0) {   //pairs with their release
+    printf( "%ld threads did not finish\n", atomic_load(&state->threads) );
+    exit (-1);
+  }
+  for (long i = 0; i < num_threads; i++) {
+    struct worker * w = &(state->workers [i]);
+    result->thread_cpu_ns += w->times.cpu_ns;
+    result->thread_loop_ns += w->times.elapsed_ns;
+    if ((result->switches.voluntary >= 0) && (w->switches.voluntary >= 0)) {
+      result->switches.voluntary += w->switches.voluntary;
+      result->switches.involuntary += w->switches.involuntary;
+    } else {
+      result->switches = w->switches;                                   //-1, not counted
+    }
+    result->expected += w->increments;
+    result->reads += w->reads;
+    result->cohort_acquires += w->cohort_acquires;
+    result->cohort_handoffs += w->cohort_handoffs;
+    result->adder_collisions += w->adder_collisions;
+    result->elide_commits += w->elide_commits;
+    result->elide_fallbacks += w->elide_fallbacks;
+    for (int a = 0; a < NUM_ABORTS; a++)
+      result->elide_aborts [a] += w->elide_aborts [a];
+    if ((result->fastest_ns < 0) || (w->times.elapsed_ns < result->fastest_ns))
+      result->fastest_ns = w->times.elapsed_ns;
+    if (w->times.elapsed_ns > result->slowest_ns)
+      result->slowest_ns = w->times.elapsed_ns;
+    for (int l = 0; l < NUM_LOCKS; l++)
+      add_lock_stats (&(result->locks [l]), &(w->lock_stats [l]));
+    struct thread_stats * t = &(result->threads [i]);
+    t->id = w->id;
+    t->cpu = w->cpu;
+    t->start_ns = w->start_ns - state->start_barrier.opened.wall_ns;
+    t->finish_ns = t->start_ns + w->times.elapsed_ns;
+    t->increments = w->increments;
+    t->reads = w->reads;
+    t->cpu_ns = w->times.cpu_ns;
+    t->switches = w->switches;
+    t->lock_waits = config->lock_stats ? w->lock_stats [LOCK_COUNT].contended : -1;
+    double rate = (w->times.elapsed_ns > 0) ?
+                  (double) (w->increments + w->reads) / w->times.elapsed_ns : 0.0;
+    rate_sum += rate;
+    rate_squares += rate * rate;
+    if (! config->perf)
+      continue;
+    for (int p = 0; p < NUM_PERF; p++)
+      result->perf [p] = ((result->perf [p] < 0) || (w->perf.values [p] < 0)) ?
+                         -1 : result->perf [p] + w->perf.values [p];
+    if (result->perf_error == 0)
+      result->perf_error = w->perf.error;
+  }
+  if (result->locks [LOCK_COUNT].acquisitions == 0)             //the mode's lock doesn't record its waits
+    for (long i = 0; i < num_threads; i++)
+      result->threads [i].lock_waits = -1;
+
+  result->times = all_times (state->start_barrier.opened);
+  result->count = state->ops->read(state);
+  result->adder_cells = (state->ops->increment == adder_increment) ?
+                        atomic_load_explicit(&state->adder_size, memory_order_relaxed) : -1;
+  result->adder_max = state->adder_max;
+  result->elide_rtm = (state->ops->lock == elided_lock) ? state->elide_rtm : -1;
+  memset (&(result->latency), 0, sizeof (result->latency));
+  for (long i = 0; i < num_threads; i++)
+    histogram_merge (&(result->latency), &(state->workers [i].latency));
+  if (state->queue != NULL) {                                           //pushed and popped instead
+    long producers = state->producers;
+    result->expected = 0;
+    result->count = 0;
+    result->pushed_sum = producers * (state->num_loops * (state->num_loops + 1) / 2);
+    result->popped_sum = 0;
+    for (long i = 0; i < num_threads; i++) {
+      struct worker * w = &(state->workers [i]);
+      if (i < producers)
+        result->expected += w->increments;
+      else
+        result->count += w->increments;
+      result->popped_sum += w->read_sum;
+    }
+    state->queue->cleanup(state);
+  }
+  if (state->ops->cleanup != NULL)
+    state->ops->cleanup(state);
+  if (config->trace != NULL)
+    write_trace (config, state);
+  for (long i = 0; i < num_threads; i++)
+    free (state->workers [i].trace_waits);
+  result->jain = (rate_squares > 0) ? rate_sum * rate_sum / (num_threads * rate_squares) : 1.0;
+
+  barrier_destroy(&state->start_barrier);
+  for (long i = 0; i < state->num_stripes; i++)
+    pthread_mutex_destroy(&(state->stripes [i].lock));
+  free (state->stripes);
+  free (state->hold_buffer);
+  free (state->workers);
+  free (state);
+  return 0;
+}
+
+static int compare_longs (const void * a, const void * b)
+{
+  long x = * (const long *) a;
+  long y = * (const long *) b;
+  return (x > y) - (x < y);
+}
+
+/* nearest-rank percentile of n sorted values */
+static long percentile (const long * sorted, int n, int pct)
+{
+  int rank = (pct * n + 99) / 100;
+  if (rank < 1)
+    rank = 1;
+  return sorted [rank - 1];
+}
+
+/* print the contention report for the mutexes the threads used */
+static void print_lock_stats (const struct lock_stats * locks)
+{
+  printf ("%-10s %12s %12s %12s %12s %12s %12s\n", "lock", "acquired", "contended",
+          "avg wait ns", "max wait ns", "avg hold ns", "max hold ns");
+  for (int l = 0; l < NUM_LOCKS; l++) {
+    const struct lock_stats * s = &(locks [l]);
+    if (s->acquisitions == 0)
+      continue;
+    printf ("%-10s %12ld %12ld %12ld %12ld %12ld %12ld\n", lock_names [l],
+            s->acquisitions, s->contended, s->wait_ns / s->acquisitions,
+            s->max_wait_ns, s->hold_ns / s->acquisitions, s->max_hold_ns);
+  }
+}
+
+/* print the hardware counters from all the threads */
+static void print_perf (const struct trial_result * result, long perf_raw, long increments)
+{
+  printf ("hardware counters:");
+  for (int p = 0; p < NUM_PERF; p++) {
+    if ((p == PERF_RAW) && (perf_raw < 0))
+      continue;
+    if (result->perf [p] < 0)
+      printf (" %s not counted;", perf_names [p]);
+    else if (p == PERF_RAW)
+      printf (" raw 0x%lx %ld;", perf_raw, result->perf [p]);
+    else
+      printf (" %s %ld (%.2f per increment);", perf_names [p], result->perf [p],
+              (increments > 0) ? (double) result->perf [p] / increments : 0.0);
+  }
+  if (result->perf_error != 0)
+    printf (" perf_event_open: %s", strerror (result->perf_error));
+  printf ("\n");
+}
+
+/* print what each thread did, and how evenly the work was spread */
+static void print_thread_stats (const struct trial_result * result, long num_threads)
+{
+  printf ("%6s %4s %12s %12s %12s %14s %14s %12s %10s %10s %10s\n", "thread", "cpu",
+          "start s", "finish s", "cpu s", "increments", "reads", "ops/s", "vol cs",
+          "invol cs", "lock waits");
+  for (long i = 0; i < num_threads; i++) {
+    const struct thread_stats * t = &(result->threads [i]);
+    long loop_ns = t->finish_ns - t->start_ns;
+    printf ("%6ld %4d %12.6f %12.6f %12.6f %14ld %14ld %12.0f ", t->id, t->cpu,
+            (double) t->start_ns / NS_PER_S, (double) t->finish_ns / NS_PER_S,
+            (double) t->cpu_ns / NS_PER_S, t->increments, t->reads,
+            (loop_ns > 0) ? (double) (t->increments + t->reads) * NS_PER_S / loop_ns : 0.0);
+    if (t->switches.voluntary < 0)
+      printf ("%10s %10s ", "-", "-");
+    else
+      printf ("%10ld %10ld ", t->switches.voluntary, t->switches.involuntary);
+    if (t->lock_waits < 0)
+      printf ("%10s\n", "-");
+    else
+      printf ("%10ld\n", t->lock_waits);
+  }
+  printf ("fairness: thread loop times from %ss to %ss, slowest/fastest %.2f, "
+          "Jain's index %.4f\n",
+          seconds (result->fastest_ns), seconds (result->slowest_ns),
+          (result->fastest_ns > 0) ? (double) result->slowest_ns / result->fastest_ns : 0.0,
+          result->jain);
+  if (result->switches.voluntary >= 0)
+    printf ("context switches: %ld voluntary, %ld involuntary\n",
+            result->switches.voluntary, result->switches.involuntary);
+}
+
+/* the elapsed time a thread spent on each of its increments or reads,
+ * averaged over the threads of a run, in ns.  This is the time of the
+ * loops added up, not the run's elapsed time, which with several
+ * threads would give the throughput rather than the cost of an
+ * operation. */
+static double ns_per_op (const struct trial_result * result)
+{
+  long ops = result->expected + result->reads;
+  return (ops > 0) ? (double) result->thread_loop_ns / ops : 0.0;
+}
+
+/* run config with one thread, as it is and with no synchronization,
+ * so that the cost per increment of the real run can be split into
+ * the loop itself, the synchronization and the contention.  Returns 0
+ * for success, or -1 after printing why. */
+static int calibrate (const struct trial_config * config, double * none_ns, double * alone_ns)
+{
+  struct trial_config baseline = *config;
+  baseline.num_threads = 1;
+  baseline.lock_stats = 0;
+  baseline.perf = 0;
+  baseline.quiet = 1;
+  baseline.trace = NULL;
+  struct trial_result result;
+  baseline.ops = find_mode ("none");                                    //one thread, so no races
+  if (run_trial (&baseline, &result) != 0)
+    return -1;
+  *none_ns = ns_per_op (&result);
+  free (result.threads);
+  baseline.ops = config->ops;
+  if (run_trial (&baseline, &result) != 0)
+    return -1;
+  *alone_ns = ns_per_op (&result);
+  free (result.threads);
+  return 0;
+}
+
+/* print how the cost per increment of a run with threads compares
+ * with the baselines from calibrate */
+static void print_calibration (const struct trial_config * config,
+                               const struct trial_result * result,
+                               double none_ns, double alone_ns)
+{
+  double ns = ns_per_op (result);
+  printf ("calibration: %.2f ns per op unsynchronized, %.2f ns with %s and 1 thread "
+          "(%.2f ns synchronization), %.2f ns per thread with %ld threads (",
+          none_ns, alone_ns, config->ops->name, alone_ns - none_ns, ns,
+          config->num_threads);
+  if (alone_ns > 0)
+    printf ("%.2fx contention overhead)\n", ns / alone_ns);
+  else
+    printf ("no contention overhead measured)\n");
+}
+
+/* print the throughput of a queue kernel run and the percentiles of
+ * the sampled operation times */
+static void print_queue_result (const struct trial_config * config,
+                                const struct trial_result * result)
+{
+  printf ("%s queue (%ld producers, %ld consumers, %ld slots): %ld pushed, %ld popped, %s, "
+          "time %ss, cpu time %ss, %.0f ops/s\n", config->queue->name,
+          config->num_threads / 2, config->num_threads - config->num_threads / 2,
+          config->queue_size, result->expected, result->count,
+          (result->pushed_sum == result->popped_sum) ? "all values arrived" : "VALUES LOST",
+          seconds (result->times.elapsed_ns), seconds (result->times.cpu_ns),
+          (result->times.elapsed_ns > 0) ?
+          (double) (result->expected + result->count) * NS_PER_S / result->times.elapsed_ns : 0.0);
+  print_histogram ("pushes and pops", (config->sample_every > 0) ? config->sample_every : SAMPLE_EVERY,
+                   &(result->latency));
+}
+
+/* what the results were measured on, for --json and --csv */
+struct system_info {
+  char cpu_model [128];
+  char compiler [128];
+  char kernel [192];                // the system and its release, e.g. Linux 6.1.0-18-amd64
+  char libc [64];
+  long cpus;
+};
+
+static const struct system_info * system_info (void)
+{
+  static struct system_info info;
+  static int known = 0;
+  if (known)
+    return &info;
+  known = 1;
+  snprintf (info.cpu_model, sizeof (info.cpu_model), "unknown");
+  FILE * cpuinfo = fopen ("/proc/cpuinfo", "r");
+  if (cpuinfo != NULL) {
+    char line [256];
+    while (fgets (line, sizeof (line), cpuinfo) != NULL) {
+      char * colon = strchr (line, ':');
+      if ((strncmp (line, "model name", 10) == 0) && (colon != NULL)) {
+        snprintf (info.cpu_model, sizeof (info.cpu_model), "%s", colon + 2);
+        info.cpu_model [strcspn (info.cpu_model, "\n")] = '\0';
+        break;
+      }
+    }
+    fclose (cpuinfo);
+  }
+#if defined (__GNUC__) && ! defined (__clang__)
+  snprintf (info.compiler, sizeof (info.compiler), "gcc %s", __VERSION__);
+#elif defined (__VERSION__)
+  snprintf (info.compiler, sizeof (info.compiler), "%s", __VERSION__);
+#else
+  snprintf (info.compiler, sizeof (info.compiler), "unknown");
+#endif
+  struct utsname name;
+  if (uname (&name) == 0)
+    snprintf (info.kernel, sizeof (info.kernel), "%s %s", name.sysname, name.release);
+  else
+    snprintf (info.kernel, sizeof (info.kernel), "unknown");
+#ifdef __GLIBC__
+  snprintf (info.libc, sizeof (info.libc), "glibc %s", gnu_get_libc_version ());
+#else
+  snprintf (info.libc, sizeof (info.libc), "unknown");
+#endif
+  info.cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  return &info;
+}
+
+/* one run for --json or --csv: the names and values of its fields,
+ * in the order they are printed */
+struct record {
+  int num_fields;
+  struct {
+    const char * name;
+    char value [256];
+    int string;                     // if set, value is quoted in the output
+  } fields [MAX_FIELDS];
+};
+
+static void record_string (struct record * r, const char * name, const char * value)
+{
+  if (r->num_fields >= MAX_FIELDS)
+    return;
+  size_t length = strlen (value);
+  if (length >= sizeof (r->fields [0].value))
+    length = sizeof (r->fields [0].value) - 1;
+  r->fields [r->num_fields].name = name;
+  memcpy (r->fields [r->num_fields].value, value, length);
+  r->fields [r->num_fields].value [length] = '\0';
+  r->fields [r->num_fields++].string = 1;
+}
+
+static void record_value (struct record * r, const char * name, const char * format, ...)
+  __attribute__ ((format (printf, 3, 4)));
+
+static void record_value (struct record * r, const char * name, const char * format, ...)
+{
+  if (r->num_fields >= MAX_FIELDS)
+    return;
+  va_list args;
+  va_start (args, format);
+  r->fields [r->num_fields].name = name;
+  vsnprintf (r->fields [r->num_fields].value, sizeof (r->fields [0].value), format, args);
+  r->fields [r->num_fields++].string = 0;
+  va_end (args);
+}
+
+/* the fields that must be the same for --compare to match two runs */
+static const char * key_fields [] = {
+  "kernel", "mode", "threads", "loops", "duration_ns", "batch", "read_percent", "counters",
+  "pick", "hold_ns", "hold_lines", "think_ns", "queue_size", "spins", "cohort_passes",
+  "indirect", "sample_every", "affinity", "numa_node"
+};
+#define NUM_KEY_FIELDS	(sizeof (key_fields) / sizeof (key_fields [0]))
+
+/* the configuration and results of one single run */
+static void make_record (struct record * r, const struct trial_config * config,
+                         const struct trial_result * result, double none_ns, double alone_ns)
+{
+  r->num_fields = 0;
+  record_string (r, "kernel", (config->queue != NULL) ? "queue" : "counter");
+  record_string (r, "mode", (config->queue != NULL) ? config->queue->name : config->ops->name);
+  record_value (r, "threads", "%ld", config->num_threads);
+  record_value (r, "loops", "%ld", config->num_loops);
+  record_value (r, "duration_ns", "%ld", config->duration_ns);
+  record_value (r, "batch", "%ld", config->batch);
+  record_value (r, "read_percent", "%d", config->read_percent);
+  record_value (r, "counters", "%ld", config->counters);
+  record_string (r, "pick", pick_names [config->pick]);
+  record_value (r, "hold_ns", "%ld", config->hold_ns);
+  record_value (r, "hold_lines", "%ld", config->hold_lines);
+  record_value (r, "think_ns", "%ld", config->think_ns);
+  record_value (r, "queue_size", "%ld", (config->queue != NULL) ? config->queue_size : 0);
+  record_value (r, "spins", "%d", config->spins);
+  record_value (r, "cohort_passes", "%ld", config->cohort_passes);
+  record_value (r, "indirect", "%s", config->indirect ? "true" : "false");
+  record_value (r, "sample_every", "%ld", config->sample_every);
+  record_string (r, "affinity", affinity_names [config->placement->affinity]);
+  record_value (r, "sockets", "%d", sockets_used (config->placement, config->num_threads));
+  record_value (r, "numa_node", "%d", config->placement->numa_node);
+  record_value (r, "count", "%ld", result->count);
+  record_value (r, "expected", "%ld", result->expected);
+  record_value (r, "reads", "%ld", result->reads);
+  int correct = (result->count == result->expected) &&
+                ((config->queue == NULL) || (result->pushed_sum == result->popped_sum));
+  record_value (r, "correct", "%s", correct ? "true" : "false");
+  record_value (r, "elapsed_ns", "%ld", result->times.elapsed_ns);
+  record_value (r, "cpu_ns", "%ld", result->times.cpu_ns);
+  record_value (r, "thread_cpu_ns", "%ld", result->thread_cpu_ns);
+  long ops = (config->queue != NULL) ? result->expected + result->count :
+             result->expected + result->reads;
+  record_value (r, "ops_per_s", "%.0f", (result->times.elapsed_ns > 0) ?
+                (double) ops * NS_PER_S / result->times.elapsed_ns : 0.0);
+  record_value (r, "jain", "%.4f", result->jain);
+  record_value (r, "voluntary_switches", "%ld", result->switches.voluntary);
+  record_value (r, "involuntary_switches", "%ld", result->switches.involuntary);
+  const struct histogram * h = &(result->latency);
+  record_value (r, "latency_samples", "%ld", h->total);
+  record_value (r, "latency_p50_ns", "%ld", h->total ? histogram_percentile (h, 50) : -1);
+  record_value (r, "latency_p90_ns", "%ld", h->total ? histogram_percentile (h, 90) : -1);
+  record_value (r, "latency_p99_ns", "%ld", h->total ? histogram_percentile (h, 99) : -1);
+  record_value (r, "latency_p999_ns", "%ld", h->total ? histogram_percentile (h, 99.9) : -1);
+  record_value (r, "latency_max_ns", "%ld", h->total ? h->max : -1);
+  record_value (r, "cohort_acquires", "%ld", result->cohort_acquires);
+  record_value (r, "cohort_handoffs", "%ld", result->cohort_handoffs);
+  record_value (r, "adder_cells", "%ld", result->adder_cells);
+  record_value (r, "adder_collisions", "%ld", result->adder_collisions);
+  record_value (r, "elide_rtm", "%d", result->elide_rtm);
+  record_value (r, "elide_commits", "%ld", result->elide_commits);
+  record_value (r, "elide_fallbacks", "%ld", result->elide_fallbacks);
+  for (int a = 0; a < NUM_ABORTS; a++)
+    record_value (r, abort_fields [a], "%ld", result->elide_aborts [a]);
+  record_value (r, "unsynchronized_ns_per_op", "%.2f", none_ns);
+  record_value (r, "uncontended_ns_per_op", "%.2f", alone_ns);
+  const struct system_info * info = system_info ();
+  record_string (r, "cpu_model", info->cpu_model);
+  record_value (r, "cpus", "%ld", info->cpus);
+  record_string (r, "compiler", info->compiler);
+  record_string (r, "os", info->kernel);
+  record_string (r, "libc", info->libc);
+}
+
+static const char * record_field (const struct record * r, const char * name)
+{
+  for (int i = 0; i < r->num_fields; i++)
+    if (strcmp (r->fields [i].name, name) == 0)
+      return r->fields [i].value;
+  return NULL;
+}
+
+static void print_json_string (const char * value)
+{
+  putchar ('"');
+  for (const char * c = value; *c != '\0'; c++) {
+    if ((*c == '"') || (*c == '\\'))
+      putchar ('\\');
+    putchar (*c);
+  }
+  putchar ('"');
+}
+
+/* print the record as one line of JSON or CSV, after the opening
+ * bracket or the header if it is the first */
+static void print_record (const struct record * r, int json, int first)
+{
+  if (json) {
+    printf ("%s\n  {", first ? "[" : ",");
+    for (int i = 0; i < r->num_fields; i++) {
+      printf ("%s\"%s\": ", (i == 0) ? "" : ", ", r->fields [i].name);
+      if (r->fields [i].string)
+        print_json_string (r->fields [i].value);
+      else
+        printf ("%s", r->fields [i].value);
+    }
+    printf ("}");
+  } else {
+    for (int i = 0; first && (i < r->num_fields); i++)
+      printf ("%s%s", (i == 0) ? "" : ",", r->fields [i].name);
+    if (first)
+      printf ("\n");
+    for (int i = 0; i < r->num_fields; i++) {
+      const char * value = r->fields [i].value;
+      if (i > 0)
+        printf (",");
+      if (strcmp (value, "null") == 0)
+        continue;                                               //empty in CSV
+      if (! r->fields [i].string) {
+        printf ("%s", value);
+        continue;
+      }
+      putchar ('"');
+      for (const char * c = value; *c != '\0'; c++) {
+        if (*c == '"')
+          putchar ('"');                                        //doubled
+        putchar (*c);
+      }
+      putchar ('"');
+    }
+    printf ("\n");
+  }
+  fflush (stdout);
+}
+
+/* the runs read from a --json file, one line each */
+struct baseline {
+  char ** lines;
+  int num_lines;
+};
+
+static int load_baseline (struct baseline * baseline, const char * file)
+{
+  baseline->lines = NULL;
+  baseline->num_lines = 0;
+  FILE * f = fopen (file, "r");
+  if (f == NULL) {
+    printf ("unable to open %s: %s\n", file, strerror (errno));
+    return -1;
+  }
+  char * line = NULL;
+  size_t size = 0;
+  int allocated = 0;
+  while (getline (&line, &size, f) >= 0) {
+    if (strstr (line, "\"ops_per_s\": ") == NULL)                      //not a run
+      continue;
+    if (baseline->num_lines == allocated) {
+      allocated = allocated ? 2 * allocated : 16;
+      char ** lines = realloc (baseline->lines, allocated * sizeof (char *));
+      if (lines == NULL) {
+        printf ("unable to read %s\n", file);
+        fclose (f);
+        return -1;
+      }
+      baseline->lines = lines;
+    }
+    baseline->lines [baseline->num_lines++] = line;
+    line = NULL;
+    size = 0;
+  }
+  free (line);
+  fclose (f);
+  if (baseline->num_lines == 0) {
+    printf ("%s has no runs, it should be the output of --json\n", file);
+    return -1;
+  }
+  return 0;
+}
+
+static void free_baseline (struct baseline * baseline)
+{
+  for (int i = 0; i < baseline->num_lines; i++)
+    free (baseline->lines [i]);
+  free (baseline->lines);
+}
+
+/* copy the value of the named field in a line written by print_record
+ * to value, without the quotes of a string.  Returns 0 if found. */
+static int json_field (const char * line, const char * name, char * value, size_t size)
+{
+  char key [64];
+  snprintf (key, sizeof (key), "\"%s\": ", name);
+  const char * start = strstr (line, key);
+  if (start == NULL)
+    return -1;
+  start += strlen (key);
+  size_t length = 0;
+  if (*start == '"') {
+    start++;
+    while ((start [length] != '\0') && (start [length] != '"'))
+      length += (start [length] == '\\') ? 2 : 1;
+  } else {
+    length = strcspn (start, ",}");
+  }
+  if (length >= size)
+    length = size - 1;
+  memcpy (value, start, length);
+  value [length] = '\0';
+  return 0;
+}
+
+/* find the baseline run with the same configuration as r, and add its
+ * throughput, the change and whether it is a regression to r.
+ * Returns 1 for a regression, otherwise 0. */
+static int compare_record (struct record * r, const struct baseline * baseline, long threshold,
+                           double * before, double * change)
+{
+  for (int i = 0; i < baseline->num_lines; i++) {
+    const char * line = baseline->lines [i];
+    char value [256];
+    size_t k = 0;
+    for (; k < NUM_KEY_FIELDS; k++) {
+      const char * mine = record_field (r, key_fields [k]);
+      if ((json_field (line, key_fields [k], value, sizeof (value)) != 0) || (mine == NULL) ||
+          (strcmp (value, mine) != 0))
+        break;
+    }
+    if ((k < NUM_KEY_FIELDS) || (json_field (line, "ops_per_s", value, sizeof (value)) != 0))
+      continue;
+    *before = strtod (value, NULL);
+    double now_ops = strtod (record_field (r, "ops_per_s"), NULL);
+    *change = (*before > 0) ? (now_ops - *before) * 100.0 / *before : 0.0;
+    int regression = (*change < -threshold);
+    record_value (r, "baseline_ops_per_s", "%.0f", *before);
+    record_value (r, "change_percent", "%.1f", *change);
+    record_value (r, "regression", "%s", regression ? "true" : "false");
+    return regression;
+  }
+  *before = -1;
+  record_value (r, "baseline_ops_per_s", "null");
+  record_value (r, "change_percent", "null");
+  record_value (r, "regression", "null");
+  return 0;
+}
+
+/* print the result of a counter run for people */
+static void print_counter_result (const struct trial_config * config,
+                                  const struct trial_result * result)
+{
+  printf ("%s", config->ops->name);
+  if (config->batch > 1)
+    printf (" (batch %ld)", config->batch);
+  if (config->counters > 1)
+    printf (" (%ld counters, %s)", config->counters, pick_names [config->pick]);
+  if (config->read_percent > 0)
+    printf (" (%d%% reads)", config->read_percent);
+  if ((config->hold_ns > 0) || (config->hold_lines > 0) || (config->think_ns > 0))
+    printf (" (hold %ld ns and %ld lines, think %ld ns)",
+            config->hold_ns, config->hold_lines, config->think_ns);
+  printf (": %ld total count, expected %ld, time %ss, cpu time %ss, "
+          "thread cpu time %ss, %.0f increments/s",
+          result->count, result->expected,
+          seconds (result->times.elapsed_ns), seconds (result->times.cpu_ns),
+          seconds (result->thread_cpu_ns),
+          (result->times.elapsed_ns > 0) ?
+          (double) result->expected * NS_PER_S / result->times.elapsed_ns : 0.0);
+  if (result->reads > 0)
+    printf (", %ld reads, %.0f reads/s", result->reads,
+            (result->times.elapsed_ns > 0) ?
+            (double) result->reads * NS_PER_S / result->times.elapsed_ns : 0.0);
+  printf ("\n");
+  if (result->cohort_acquires > 0)
+    printf ("cohorts: %ld sockets, global lock taken %ld times, passed within a socket "
+            "%ld times (%.1f per global acquisition, at most %ld)\n",
+            result->cohorts, result->cohort_acquires, result->cohort_handoffs,
+            (double) result->cohort_handoffs / result->cohort_acquires, config->cohort_passes);
+  if (result->adder_cells >= 0)
+    printf ("adder: %ld cells (at most %ld), after %ld failed compare and swaps\n",
+            result->adder_cells, result->adder_max, result->adder_collisions);
+  if (result->elide_rtm == 0)
+    printf ("elision: no RTM on this CPU (or it is disabled), all %ld critical sections "
+            "took countLock\n", result->elide_fallbacks);
+  if (result->elide_rtm > 0) {
+    printf ("elision: %ld critical sections committed as transactions, %ld took countLock; "
+            "aborts:", result->elide_commits, result->elide_fallbacks);
+    for (int a = 0; a < NUM_ABORTS; a++)
+      printf (" %s %ld", abort_names [a], result->elide_aborts [a]);
+    printf ("\n");
+  }
+}
+
+/* print one single run as the options say, and compare it with the
+ * baseline if there is one.  Returns 1 for a regression, otherwise 0. */
+static int report_run (const struct options * opts, const struct trial_config * config,
+                       const struct trial_result * result, double none_ns, double alone_ns,
+                       const struct baseline * baseline, int first)
+{
+  struct record r;
+  make_record (&r, config, result, none_ns, alone_ns);
+  double before = -1;
+  double change = 0.0;
+  int regression = (baseline != NULL) ?
+                   compare_record (&r, baseline, opts->threshold, &before, &change) : 0;
+  if (opts->json || opts->csv) {
+    print_record (&r, opts->json, first);
+    return regression;
+  }
+  if (config->queue != NULL) {
+    print_queue_result (config, result);
+  } else {
+    print_counter_result (config, result);
+  }
+  print_thread_stats (result, config->num_threads);
+  if (config->queue == NULL) {
+    if (opts->calibrate)
+      print_calibration (config, result, none_ns, alone_ns);
+    print_histogram ("lock and increments", config->sample_every, &(result->latency));
+    if (config->perf)
+      print_perf (result, config->perf_raw, result->expected);
+    if (config->lock_stats)
+      print_lock_stats (result->locks);
+  }
+  if (baseline == NULL)
+    return regression;
+  if (before < 0)
+    printf ("compare: no run with this configuration in %s\n", opts->compare);
+  else
+    printf ("compare: %s ops/s, baseline %.0f ops/s, %+.1f%%%s\n",
+            record_field (&r, "ops_per_s"), before, change,
+            regression ? ", REGRESSION" : "");
+  return regression;
+}
+
+/* the statistics printed for each sweep configuration */
+struct summary {
+  long min;
+  long median;
+  long p99;
+};
+
+/* sorts the n values */
+static struct summary summarize (long * values, int n)
+{
+  qsort (values, n, sizeof (long), compare_longs);
+  struct summary result =
+    { .min = values [0], .median = percentile (values, n, 50),
+      .p99 = percentile (values, n, 99) };
+  return result;
+}
+
+/* the next value in a sweep: multiply by factor, but stop at pivot
+ * on the way past it so that it is always included */
+static long next_step (long value, long factor, long pivot)
+{
+  if (value < pivot && value * factor > pivot)
+    return pivot;
+  return value * factor;
+}
+
+/* run config opts->repeat times and print one line (CSV) or object
+ * (JSON) summarizing the runs */
+static int sweep_config (const struct options * opts, const struct trial_config * config,
+                         int first, long * elapsed, long * cpu, long * thread_cpu,
+                         long * spread, long * rate)
+{
+  int wrong = 0;
+  for (int r = 0; r < opts->repeat; r++) {
+    struct trial_result result;
+    if (run_trial (config, &result) != 0)
+      return -1;
+    elapsed [r] = result.times.elapsed_ns;
+    cpu [r] = result.times.cpu_ns;
+    thread_cpu [r] = result.thread_cpu_ns;
+    spread [r] = result.slowest_ns - result.fastest_ns;
+    rate [r] = (result.times.elapsed_ns > 0) ?
+               (long) ((double) (result.expected + result.reads) * NS_PER_S /
+                       result.times.elapsed_ns) : 0;
+    if (result.count != result.expected)
+      wrong++;
+    free (result.threads);
+  }
+  struct summary e = summarize (elapsed, opts->repeat);
+  struct summary c = summarize (cpu, opts->repeat);
+  struct summary tc = summarize (thread_cpu, opts->repeat);
+  struct summary sp = summarize (spread, opts->repeat);
+  struct summary rt = summarize (rate, opts->repeat);
+  if (opts->json)
+    printf ("%s\n  {\"mode\": \"%s\", \"threads\": %ld, \"loops\": %ld, "
+            "\"duration_ns\": %ld, \"batch\": %ld, \"read_percent\": %d, "
+            "\"counters\": %ld, \"pick\": \"%s\", "
+            "\"hold_ns\": %ld, \"hold_lines\": %ld, \"think_ns\": %ld, "
+            "\"affinity\": \"%s\", \"sockets\": %d, \"numa_node\": %d, "
+            "\"runs\": %d, \"wrong_counts\": %d,\n"
+            "   \"elapsed_ns\": {\"min\": %ld, \"median\": %ld, \"p99\": %ld},\n"
+            "   \"cpu_ns\": {\"min\": %ld, \"median\": %ld, \"p99\": %ld},\n"
+            "   \"thread_cpu_ns\": {\"min\": %ld, \"median\": %ld, \"p99\": %ld},\n"
+            "   \"thread_spread_ns\": {\"min\": %ld, \"median\": %ld, \"p99\": %ld},\n"
+            "   \"ops_per_s\": {\"min\": %ld, \"median\": %ld, \"p99\": %ld}}",
+            first ? "" : ",", config->ops->name, config->num_threads,
+            config->num_loops, config->duration_ns, config->batch, config->read_percent,
+            config->counters, pick_names [config->pick],
+            config->hold_ns, config->hold_lines, config->think_ns,
+            affinity_names [config->placement->affinity],
+            sockets_used (config->placement, config->num_threads),
+            config->placement->numa_node, opts->repeat, wrong,
+            e.min, e.median, e.p99, c.min, c.median, c.p99,
+            tc.min, tc.median, tc.p99, sp.min, sp.median, sp.p99,
+            rt.min, rt.median, rt.p99);
+  else
+    printf ("%s,%ld,%ld,%ld,%ld,%d,%ld,%s,%ld,%ld,%ld,%s,%d,%d,%d,%d,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,%ld,"
+            "%ld,%ld,%ld\n",
+            config->ops->name, config->num_threads, config->num_loops,
+            config->duration_ns, config->batch, config->read_percent, config->counters,
+            pick_names [config->pick], config->hold_ns, config->hold_lines,
+            config->think_ns, affinity_names [config->placement->affinity],
+            sockets_used (config->placement, config->num_threads),
+            config->placement->numa_node, opts->repeat, wrong,
+            e.min, e.median, e.p99, c.min, c.median, c.p99,
+            tc.min, tc.median, tc.p99, sp.min, sp.median, sp.p99,
+            rt.min, rt.median, rt.p99);
+  fflush (stdout);
+  return 0;
+}
+
+/* run every mode, batch size, thread count and loop count
+ * opts->repeat times, and print min/median/p99 of the elapsed and
+ * CPU times for each */
+static int sweep (const struct options * opts)
+{
+  long max_threads = opts->num_threads;
+  long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+  if (! opts->threads_given)
+    max_threads = 2 * ((cpus > 0) ? cpus : 1);                          //go beyond the CPUs to oversubscribe
+  long * elapsed = malloc (opts->repeat * sizeof (long));
+  long * cpu = malloc (opts->repeat * sizeof (long));
+  long * thread_cpu = malloc (opts->repeat * sizeof (long));
+  long * spread = malloc (opts->repeat * sizeof (long));
+  long * rate = malloc (opts->repeat * sizeof (long));
+  if ((elapsed == NULL) || (cpu == NULL) || (thread_cpu == NULL) || (spread == NULL) ||
+      (rate == NULL)) {
+    printf( "unable to allocate %d results\n", opts->repeat );
+    return -1;
+  }
+  struct pool pool;
+  if (pool_create (&pool, max_threads, &(opts->placement)) != 0)
+    return -1;
+  if (opts->json)
+    printf ("[");
+  else
+    printf ("mode,threads,loops,duration_ns,batch,read_percent,counters,pick,"
+            "hold_ns,hold_lines,think_ns,affinity,sockets,numa_node,runs,wrong_counts,"
+            "elapsed_min_ns,elapsed_median_ns,elapsed_p99_ns,"
+            "cpu_min_ns,cpu_median_ns,cpu_p99_ns,"
+            "thread_cpu_min_ns,thread_cpu_median_ns,thread_cpu_p99_ns,"
+            "thread_spread_min_ns,thread_spread_median_ns,thread_spread_p99_ns,"
+            "ops_per_s_min,ops_per_s_median,ops_per_s_p99\n");
+  int first = 1;
+  struct trial_config config =
+    { .placement = &(opts->placement), .duration_ns = opts->duration_ns,
+      .read_percent = opts->read_percent, .pick = opts->pick, .spins = opts->spins,
+      .cohort_passes = opts->cohort_passes,
+      .hold_ns = opts->hold_ns, .hold_lines = opts->hold_lines, .think_ns = opts->think_ns,
+      .indirect = opts->indirect,
+      .perf_raw = -1, .quiet = 1, .pool = &pool };
+  for (int m = 0; m < opts->num_modes; m++) {
+    config.ops = opts->modes [m];
+    for (int b = 0; b < opts->num_batches; b++) {
+      config.batch = opts->batches [b];
+      for (int c = 0; c < opts->num_counters; c++) {
+        config.counters = opts->counters [c];
+        for (long t = 1; t <= max_threads; t = next_step (t, 2, (t < cpus) ? cpus : max_threads)) {
+          config.num_threads = t;
+          long first_loops = (opts->num_loops < 1000) ? opts->num_loops : 1000;
+          if (opts->duration_ns > 0)                                    //a timed run: the loops don't matter
+            first_loops = opts->num_loops;
+          for (long l = first_loops; l <= opts->num_loops; l = next_step (l, 10, opts->num_loops)) {
+            config.num_loops = (opts->duration_ns > 0) ? 0 : l;
+            if (sweep_config (opts, &config, first, elapsed, cpu, thread_cpu, spread, rate) != 0)
+              return -1;
+            first = 0;
+            if (l == opts->num_loops)
+              break;
+          }
+        }
+      }
+    }
+  }
+  if (opts->json)
+    printf ("\n]\n");
+  pool_destroy (&pool);
+  free (elapsed);
+  free (cpu);
+  free (thread_cpu);
+  free (spread);
+  free (rate);
+  return 0;
+}
+
+/* parse a comma-separated list of at most MAX_LIST numbers, each at
+ * least min.  Returns the number of values, or -1 after printing why. */
+static int parse_list (const char * option, char * list, long min, long * values)
+{
+  int count = 0;
+  char * item;
+  while ((item = strsep (&list, ",")) != NULL) {
+    char * end;
+    long value = strtol (item, &end, 10);
+    if ((*item == '\0') || (*end != '\0') || (value < min)) {
+      printf ("%s: %s is not a number of at least %ld\n", option, item, min);
+      return -1;
+    }
+    if (count >= MAX_LIST) {
+      printf ("%s: at most %d values\n", option, MAX_LIST);
+      return -1;
+    }
+    values [count++] = value;
+  }
+  return count;
+}
+
+/* fill in opts from the command line.  Returns 0 for success, or -1
+ * after printing the reason and the usage. */
+static int parse_options (int argc, char ** argv, struct options * opts)
+{
+  //separate the --options from the positional arguments
+  char * args [3] = { argv [0], NULL, NULL };
+  int nargs = 1;
+  opts->num_modes = 0;
+  opts->batches [0] = 1;
+  opts->num_batches = 1;
+  opts->sweep = 0;
+  opts->repeat = REPEAT;
+  opts->json = 0;
+  opts->csv = 0;
+  opts->compare = NULL;
+  opts->threshold = THRESHOLD;
+  opts->lock_stats = 0;
+  opts->perf = 0;
+  opts->perf_raw = -1;
+  opts->spins = SPINS;
+  opts->cohort_passes = COHORT_PASSES;
+  opts->duration_ns = 0;
+  opts->read_percent = 0;
+  opts->calibrate = 1;
+  opts->counters [0] = 1;
+  opts->num_counters = 1;
+  opts->pick = PICK_ROUND_ROBIN;
+  opts->hold_ns = 0;
+  opts->hold_lines = 0;
+  opts->think_ns = 0;
+  opts->oversubscribe = 0;
+  opts->num_queues = 0;
+  opts->queue_size = QUEUE_SIZE;
+  opts->sample_every = 0;
+  opts->indirect = 0;
+  opts->trace.file = NULL;
+  opts->trace.path = NULL;
+  opts->placement.affinity = AFFINITY_NONE;
+  opts->placement.numa_node = -1;
+  for (int i = 1; i < argc; i++) {
+    if (strncmp (argv [i], "--mode=", 7) == 0) {
+      char * names = argv [i] + 7;
+      char * name;
+      while ((name = strsep (&names, ",")) != NULL) {
+        const struct sync_ops * ops = find_mode (name);
+        if (ops == NULL) {
+          printf ("unknown mode %s\n", name);
+          usage (argv [0]);
+          return -1;
+        }
+        if (opts->num_modes < (int) NUM_MODES)
+          opts->modes [opts->num_modes++] = ops;
+      }
+    } else if (strncmp (argv [i], "--batch=", 8) == 0) {
+      opts->num_batches = parse_list ("--batch", argv [i] + 8, 1, opts->batches);
+      if (opts->num_batches < 0)
+        return -1;
+    } else if (strcmp (argv [i], "--sweep") == 0) {
+      opts->sweep = 1;
+    } else if (strncmp (argv [i], "--repeat=", 9) == 0) {
+      opts->repeat = atoi (argv [i] + 9);
+      if (opts->repeat < 1) {
+        printf ("repeat must be at least 1\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--counters=", 11) == 0) {
+      opts->num_counters = parse_list ("--counters", argv [i] + 11, 1, opts->counters);
+      if (opts->num_counters < 0)
+        return -1;
+    } else if (strncmp (argv [i], "--hold=", 7) == 0) {
+      if (parse_list ("--hold", argv [i] + 7, 0, &(opts->hold_ns)) != 1) {
+        printf ("--hold needs one number of ns\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--hold-lines=", 13) == 0) {
+      if (parse_list ("--hold-lines", argv [i] + 13, 0, &(opts->hold_lines)) != 1) {
+        printf ("--hold-lines needs one number of cache lines\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--think=", 8) == 0) {
+      if (parse_list ("--think", argv [i] + 8, 0, &(opts->think_ns)) != 1) {
+        printf ("--think needs one number of ns\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--oversubscribe=", 16) == 0) {
+      if (parse_list ("--oversubscribe", argv [i] + 16, 1, &(opts->oversubscribe)) != 1) {
+        printf ("--oversubscribe needs one number of threads per CPU\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--queue=", 8) == 0) {
+      char * names = argv [i] + 8;
+      char * name;
+      while ((name = strsep (&names, ",")) != NULL) {
+        const struct queue_ops * queue = find_queue (name);
+        if (queue == NULL) {
+          printf ("unknown queue %s, must be condvar or mpmc\n", name);
+          return -1;
+        }
+        if (opts->num_queues < (int) NUM_QUEUES)
+          opts->queues [opts->num_queues++] = queue;
+      }
+    } else if (strncmp (argv [i], "--trace=", 8) == 0) {
+      opts->trace.path = argv [i] + 8;
+    } else if (strcmp (argv [i], "--indirect") == 0) {
+      opts->indirect = 1;
+    } else if (strcmp (argv [i], "--latency") == 0) {
+      opts->sample_every = SAMPLE_EVERY;
+    } else if (strncmp (argv [i], "--latency=", 10) == 0) {
+      if (parse_list ("--latency", argv [i] + 10, 1, &(opts->sample_every)) != 1) {
+        printf ("--latency needs one number of operations\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--queue-size=", 13) == 0) {
+      if ((parse_list ("--queue-size", argv [i] + 13, 1, &(opts->queue_size)) != 1) ||
+          ((opts->queue_size & (opts->queue_size - 1)) != 0)) {
+        printf ("--queue-size needs one power of 2\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--pick=", 7) == 0) {
+      opts->pick = -1;
+      for (int p = 0; p < (int) (sizeof (pick_names) / sizeof (pick_names [0])); p++)
+        if (strcmp (argv [i] + 7, pick_names [p]) == 0)
+          opts->pick = p;
+      if (opts->pick < 0) {
+        printf ("--pick must be roundrobin, random or thread\n");
+        return -1;
+      }
+    } else if (strcmp (argv [i], "--no-calibrate") == 0) {
+      opts->calibrate = 0;
+    } else if (strcmp (argv [i], "--json") == 0) {
+      opts->json = 1;
+    } else if (strcmp (argv [i], "--csv") == 0) {
+      opts->csv = 1;
+    } else if (strncmp (argv [i], "--compare=", 10) == 0) {
+      opts->compare = argv [i] + 10;
+    } else if (strncmp (argv [i], "--threshold=", 12) == 0) {
+      if (parse_list ("--threshold", argv [i] + 12, 0, &(opts->threshold)) != 1) {
+        printf ("--threshold needs one percentage\n");
+        return -1;
+      }
+    } else if (strcmp (argv [i], "--perf") == 0) {
+      opts->perf = 1;
+    } else if (strncmp (argv [i], "--perf-raw=", 11) == 0) {
+      char * end;
+      opts->perf = 1;
+      opts->perf_raw = strtol (argv [i] + 11, &end, 0);
+      if ((argv [i] [11] == '\0') || (*end != '\0') || (opts->perf_raw < 0)) {
+        printf ("--perf-raw needs an event number, e.g. 0x4d2 or 1234\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--duration=", 11) == 0) {
+      char * end;
+      double duration = strtod (argv [i] + 11, &end);
+      if ((argv [i] [11] == '\0') || (*end != '\0') || (duration <= 0) || (duration > 1e6)) {
+        printf ("--duration needs a number of seconds\n");
+        return -1;
+      }
+      opts->duration_ns = duration * NS_PER_S;
+    } else if (strncmp (argv [i], "--read-ratio=", 13) == 0) {
+      if (parse_list ("--read-ratio", argv [i] + 13, 0, &(opts->read_percent)) != 1 ||
+          opts->read_percent > 100) {
+        printf ("--read-ratio needs one percentage\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--spins=", 8) == 0) {
+      if (parse_list ("--spins", argv [i] + 8, 0, &(opts->spins)) != 1 || opts->spins > 1000000000) {
+        printf ("--spins needs one number of tries\n");
+        return -1;
+      }
+    } else if (strncmp (argv [i], "--cohort-passes=", 16) == 0) {
+      if (parse_list ("--cohort-passes", argv [i] + 16, 0, &(opts->cohort_passes)) != 1) {
+        printf ("--cohort-passes needs one number of handoffs\n");
+        return -1;
+      }
+    } else if (strcmp (argv [i], "--lockstats") == 0) {
+      opts->lock_stats = 1;
+    } else if (strncmp (argv [i], "--affinity=", 11) == 0) {
+      if (set_placement (&(opts->placement), argv [i] + 11) != 0)
+        return -1;
+    } else if (strncmp (argv [i], "--numa=", 7) == 0) {
+      long node;
+      if (parse_list ("--numa", argv [i] + 7, 0, &node) != 1 || node > 62) {
+        printf ("--numa needs one node number\n");
+        return -1;
+      }
+#ifndef HAVE_AFFINITY
+      printf ("--numa: NUMA placement is not supported on this system\n");
+      return -1;
+#endif
+      opts->placement.numa_node = node;
+    } else if (argv [i] [0] == '-' && argv [i] [1] == '-') {
+      printf ("unknown option %s\n", argv [i]);
+      usage (argv [0]);
+      return -1;
+    } else if (nargs < 3) {
+      args [nargs++] = argv [i];
+    } else {
+      usage (argv [0]);
+      return -1;
+    }
+  }
+  if (opts->num_modes == 0)
+    opts->modes [opts->num_modes++] = find_mode ("mutex");
+  for (int c = 0; c < opts->num_counters; c++)
+    for (int m = 0; (m < opts->num_modes) && (opts->counters [c] > 1); m++)
+      if ((opts->modes [m]->increment != plain_increment) &&
+          (opts->modes [m]->increment != stripe_increment)) {
+        printf ("mode %s has only one counter, --counters needs a locked mode, "
+                "striped or none\n", opts->modes [m]->name);
+        return -1;
+      }
+  opts->num_threads = (nargs <= 1) ? THREADS : atoi (args[1]);          //am I true ? if yes : if no //is no arguement #of threads = 2, else it equals user input
+  opts->threads_given = (nargs > 1);
+  if (opts->oversubscribe > 0) {                                        //more threads than CPUs, instead
+    long cpus = sysconf (_SC_NPROCESSORS_ONLN);
+    opts->num_threads = opts->oversubscribe * ((cpus > 0) ? cpus : 1);
+    opts->threads_given = 1;
+  }
+  opts->num_loops = (nargs <= 2) ? LOOPS : atoi (args[2]);              //10 * 1000 * 1000 unless another argument is specified 
+  if (opts->num_threads < 1 || opts->num_loops < 0) {
+    printf ("need at least one thread and no negative loops\n");
+    return -1;
+  }
+  if ((opts->num_queues > 0) &&
+      (opts->sweep || (opts->duration_ns > 0) || (opts->num_threads < 2))) {
+    printf ("--queue needs at least 2 threads, and no --sweep or --duration\n");
+    return -1;
+  }
+  if (opts->num_queues > 0)                                             //the queues instead of the modes
+    opts->num_modes = 0;
+  if (opts->json && opts->csv) {
+    printf ("--json and --csv cannot be combined\n");
+    return -1;
+  }
+  if (opts->sweep && (opts->compare != NULL)) {
+    printf ("--compare only compares single runs, not sweeps\n");
+    return -1;
+  }
+  return 0;
+}
+
+int main (int argc, char ** argv)
+{
+  struct options opts;
+  if (parse_options (argc, argv, &opts) != 0)
+    return -1;
+
+  //initialize the mutex 
+  if (pthread_mutex_init(&countLock, NULL) != 0){
+    printf( "countLock mutex initialization failed\n" );
+    return -1; 
+  }
+  pthread_mutexattr_t adaptive;
+  pthread_mutexattr_init(&adaptive);
+#ifdef PTHREAD_ADAPTIVE_MUTEX_INITIALIZER_NP                            //glibc: spin briefly before sleeping
+  pthread_mutexattr_settype(&adaptive, PTHREAD_MUTEX_ADAPTIVE_NP);
+#endif
+  if (pthread_mutex_init(&adaptiveLock, &adaptive) != 0){
+    printf( "adaptiveLock mutex initialization failed\n" );
+    return -1; 
+  }
+  pthread_mutexattr_destroy(&adaptive);
+  if (pthread_rwlock_init(&countRwLock, NULL) != 0){
+    printf( "countRwLock initialization failed\n" );
+    return -1; 
+  }
+  if (pthread_mutex_init(&decreLock, NULL) != 0){
+    printf( "decreLock mutex initialization failed\n" );
+    return -1; 
+  }
+
+  int regressions = 0;                                                  //with --compare
+  if (opts.sweep) {
+    if (sweep (&opts) != 0)
+      return -1;
+  } else {
+    struct trial_config config =
+      { .num_threads = opts.num_threads, .num_loops = opts.num_loops,
+        .duration_ns = opts.duration_ns, .read_percent = opts.read_percent,
+        .placement = &(opts.placement), .lock_stats = opts.lock_stats,
+        .perf = opts.perf, .perf_raw = opts.perf_raw, .spins = opts.spins, .quiet = 0,
+        .cohort_passes = opts.cohort_passes,
+        .pick = opts.pick, .hold_ns = opts.hold_ns, .hold_lines = opts.hold_lines,
+        .think_ns = opts.think_ns, .sample_every = opts.sample_every,
+        .indirect = opts.indirect, .trace = NULL };
+    if (opts.trace.path != NULL) {
+      if (open_trace (&(opts.trace)) != 0)
+        return -1;
+      config.trace = &(opts.trace);
+    }
+    struct pool pool;
+    if (pool_create (&pool, opts.num_threads, &(opts.placement)) != 0)
+      return -1;
+    config.pool = &pool;
+    struct baseline baseline;
+    if ((opts.compare != NULL) && (load_baseline (&baseline, opts.compare) != 0))
+      return -1;
+    const struct baseline * compare = (opts.compare != NULL) ? &baseline : NULL;
+    if (opts.json || opts.csv)
+      config.quiet = 1;                                                 //nothing but the records
+    else
+      print_placement (&(opts.placement), opts.num_threads);
+    int first = 1;
+    for (int m = 0; m < opts.num_modes; m++) {
+      config.ops = opts.modes [m];
+      for (int b = 0; b < opts.num_batches; b++) {
+        config.batch = opts.batches [b];
+        for (int c = 0; c < opts.num_counters; c++) {
+          config.counters = opts.counters [c];
+          double none_ns = 0.0;
+          double alone_ns = 0.0;
+          if (opts.calibrate && (calibrate (&config, &none_ns, &alone_ns) != 0))
+            return -1;
+          struct trial_result result;
+          if (run_trial (&config, &result) != 0)
+            return -1;
+          regressions += report_run (&opts, &config, &result, none_ns, alone_ns, compare, first);
+          first = 0;
+          free (result.threads);
+        }
+      }
+    }
+    config.ops = find_mode ("mutex");                                  //not used by the queue kernel
+    config.queue_size = opts.queue_size;
+    for (int q = 0; q < opts.num_queues; q++) {
+      config.queue = opts.queues [q];
+      struct trial_result result;
+      if (run_trial (&config, &result) != 0)
+        return -1;
+      regressions += report_run (&opts, &config, &result, 0.0, 0.0, compare, first);
+      first = 0;
+      free (result.threads);
+    }
+    if (opts.json)
+      printf ("\n]\n");
+    if (config.trace != NULL)
+      close_trace (config.trace, config.quiet);
+    if (compare != NULL)
+      free_baseline (&baseline);
+    pool_destroy (&pool);
+  }
+
+  pthread_mutex_destroy(&decreLock);
+  pthread_mutex_destroy(&adaptiveLock);
+  pthread_rwlock_destroy(&countRwLock);
+  pthread_mutex_destroy(&countLock);
+
+  #ifdef DEBUG
+    printf("end of program\n");
+  #endif 
+  return (regressions > 0) ? 1 : 0; 
+}